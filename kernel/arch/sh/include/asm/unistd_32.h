@@ -373,8 +373,21 @@
 #define __NR_getsockopt    354
 #define __NR_sendmsg       355
 #define __NR_recvmsg       356
+/*
+ Currently not defined in STLinux kernel
+ Included and commented just to keep the number allocated
+ for the new syscalls available on mainstream
+
+#define __NR_recvmmsg		357
+#define __NR_accept4		358
+#define __NR_name_to_handle_at	359
+#define __NR_open_by_handle_at	360
+#define __NR_clock_adjtime	361
+#define __NR_syncfs		362
+*/
+#define __NR_sendmmsg		363
 
-#define NR_syscalls 357
+#define NR_syscalls 364
 
 #ifdef __KERNEL__
 
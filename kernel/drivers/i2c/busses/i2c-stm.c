@@ -77,6 +77,7 @@
 #include <linux/interrupt.h>
 #include <linux/wait.h>
 #include <linux/errno.h>
+#include <linux/ktime.h>
 #include <linux/stm/platform.h>
 #include <linux/stm/ssc.h>
 #include "i2c-stm.h"
@@ -153,6 +154,28 @@
 #define IIC_STM_READY_SPEED_MASK	   0x2
 #define IIC_STM_READY_SPEED_FAST	   0x2
 
+/*
+ * Latency statistics, in log2 microsecond slots: slot 0 is < 1us,
+ * slot n is [2^(n-1), 2^n) us and the last slot takes everything else.
+ */
+#define IIC_STM_HIST_SLOTS		16
+
+struct iic_stm_hist {
+	u32 count;
+	u32 max;
+	u64 sum;
+	u32 slot[IIC_STM_HIST_SLOTS];
+};
+
+struct iic_stm_stats {
+	struct iic_stm_hist xfer[0x80][2];	/* [addr][fastmode] */
+	struct iic_stm_hist free_bus;
+	struct iic_stm_hist stop_cond;
+	u32 free_bus_timeout;
+	u32 stop_cond_timeout;
+	u32 errors;
+};
+
 enum iic_state_machine {
 	IIC_FSM_VOID = 0,
 	IIC_FSM_IDLE,
@@ -210,6 +233,7 @@ struct iic_ssc {
 	unsigned long config;
 	wait_queue_head_t wait_queue;
 	struct stm_pad_state *pad_state;
+	struct iic_stm_stats *stats;
 };
 
 #define jump_on_fsm_start(x)	{ (x)->state = IIC_FSM_START;	\
@@ -674,20 +698,44 @@ be_fsm_complete:
 	return IRQ_HANDLED;
 }
 
+static void iic_stm_hist_add(struct iic_stm_hist *hist, ktime_t start)
+{
+	s64 delta = ktime_to_us(ktime_sub(ktime_get(), start));
+	u32 us = delta > 0 ? (delta < 0xffffffff ? delta : 0xffffffff) : 0;
+	int slot = fls(us);
+
+	if (slot >= IIC_STM_HIST_SLOTS)
+		slot = IIC_STM_HIST_SLOTS - 1;
+	hist->slot[slot]++;
+	hist->count++;
+	hist->sum += us;
+	if (us > hist->max)
+		hist->max = us;
+}
+
 /*
  * Wait for stop to be detected on bus
  */
 static int iic_wait_stop_condition(struct iic_ssc *adap)
 {
 	unsigned int idx;
+	ktime_t start = ktime_get();
 
 	dbg_print("\n");
 	for (idx = 0; idx < 5; ++idx) {
-		if (ssc_load32(adap, SSC_STA) & SSC_STA_STOP)
+		if (ssc_load32(adap, SSC_STA) & SSC_STA_STOP) {
+			if (adap->stats)
+				iic_stm_hist_add(&adap->stats->stop_cond,
+						 start);
 			return 1;
+		}
 		mdelay(2);
 	}
 
+	if (adap->stats) {
+		iic_stm_hist_add(&adap->stats->stop_cond, start);
+		adap->stats->stop_cond_timeout++;
+	}
 	printk(KERN_ERR "*** iic_wait_stop_condition: TIMED OUT ***\n");
 	return 0;
 }
@@ -725,6 +773,7 @@ static int iic_wait_free_bus(struct iic_ssc *adap)
 {
 	unsigned int reg = 0;
 	unsigned int idx;
+	ktime_t start = ktime_get();
 
 	dbg_print("\n");
 
@@ -737,11 +786,19 @@ static int iic_wait_free_bus(struct iic_ssc *adap)
 	for (idx = 0; idx < 10; ++idx) {
 		reg = ssc_load32(adap, SSC_STA);
 		dbg_print("iic_wait_free_bus: status = 0x%08x\n", reg);
-		if (!(reg & SSC_STA_BUSY))
+		if (!(reg & SSC_STA_BUSY)) {
+			if (adap->stats)
+				iic_stm_hist_add(&adap->stats->free_bus,
+						 start);
 			return 1;
+		}
 		mdelay(2);
 	}
 
+	if (adap->stats) {
+		iic_stm_hist_add(&adap->stats->free_bus, start);
+		adap->stats->free_bus_timeout++;
+	}
 	printk(KERN_ERR "*** iic_wait_free_bus: TIMED OUT ***\n");
 
 	return 0;
@@ -800,6 +857,7 @@ static int iic_stm_xfer(struct i2c_adapter *i2c_adap,
 	unsigned long flag;
 	int result;
 	int timeout;
+	ktime_t start = ktime_get();
 #ifdef CONFIG_I2C_DEBUG_BUS
 	int i;
 #endif
@@ -992,6 +1050,17 @@ iic_xfer_retry:
 	} else
 		local_irq_restore(flag);
 
+	/*
+	 * Account the whole transfer (retries included) to the last
+	 * message: behind a repeater that is the device really addressed
+	 */
+	if (adap->stats && num > 0) {
+		iic_stm_hist_add(&adap->stats->xfer[msgs[num - 1].addr & 0x7f]
+				 [check_fastmode(adap)], start);
+		if (result < 0)
+			adap->stats->errors++;
+	}
+
 #ifdef CONFIG_I2C_DEBUG_BUS
 	printk(KERN_INFO "i2c-stm: i2c_stm_xfer returned %d\n", result);
 #endif
@@ -1200,6 +1269,105 @@ static ssize_t iic_bus_store_fastmode(struct device *dev,
 static DEVICE_ATTR(fastmode, S_IRUGO | S_IWUSR, iic_bus_show_fastmode,
 		   iic_bus_store_fastmode);
 
+static int iic_bus_show_hist(char *buf, int len, const char *name,
+			     struct iic_stm_hist *hist)
+{
+	u64 avg = hist->sum;
+	int i;
+
+	do_div(avg, hist->count);
+	len += scnprintf(buf + len, PAGE_SIZE - len,
+			 "%-10s %8u %7u %7u", name, hist->count,
+			 (u32)avg, hist->max);
+	for (i = 0; i < IIC_STM_HIST_SLOTS; i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len, " %u",
+				 hist->slot[i]);
+	len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+	return len;
+}
+
+/*
+ * Transfer and bus wait durations in microseconds; the columns after
+ * max are the log2 slots <1, <2, <4 ... <16384 and >=16384 us.
+ * The statistics are off by default, writing 1 to the file enables
+ * (or clears) them and 0 disables them and frees the counters.
+ */
+static ssize_t iic_bus_show_latency(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	struct i2c_adapter *adapter =
+	    container_of(dev, struct i2c_adapter, dev);
+	struct iic_ssc *iic_stm =
+	    container_of(adapter, struct iic_ssc, adapter);
+	struct iic_stm_stats *stats;
+	char name[16];
+	int len, addr, fast;
+
+	/* the transfers update and the store frees the counters locked */
+	i2c_lock_adapter(adapter);
+	stats = iic_stm->stats;
+	if (!stats) {
+		i2c_unlock_adapter(adapter);
+		return scnprintf(buf, PAGE_SIZE, "disabled\n");
+	}
+
+	len = scnprintf(buf, PAGE_SIZE, "fastmode %u glitch %u/%uns "
+			"errors %u free_bus_timeout %u stop_timeout %u\n",
+			check_fastmode(iic_stm), GLITCH_WIDTH_DATA,
+			GLITCH_WIDTH_CLOCK, stats->errors,
+			stats->free_bus_timeout, stats->stop_cond_timeout);
+	len += scnprintf(buf + len, PAGE_SIZE - len,
+			 "%-10s %8s %7s %7s %s\n", "what", "count", "avg",
+			 "max", "slots");
+	if (stats->free_bus.count)
+		len = iic_bus_show_hist(buf, len, "free_bus",
+					&stats->free_bus);
+	if (stats->stop_cond.count)
+		len = iic_bus_show_hist(buf, len, "stop_cond",
+					&stats->stop_cond);
+	for (addr = 0; addr < 0x80; addr++)
+		for (fast = 0; fast < 2; fast++) {
+			if (!stats->xfer[addr][fast].count)
+				continue;
+			sprintf(name, "0x%02x/%s", addr, fast ? "fast" : "std");
+			len = iic_bus_show_hist(buf, len, name,
+						&stats->xfer[addr][fast]);
+		}
+	i2c_unlock_adapter(adapter);
+	return len;
+}
+
+static ssize_t iic_bus_store_latency(struct device *dev,
+				     struct device_attribute *attr,
+				     const char *buf, size_t count)
+{
+	struct i2c_adapter *adapter =
+	    container_of(dev, struct i2c_adapter, dev);
+	struct iic_ssc *iic_stm =
+	    container_of(adapter, struct iic_ssc, adapter);
+	struct iic_stm_stats *stats = NULL;
+	unsigned long val;
+
+	if (strict_strtoul(buf, 10, &val) || val > 1)
+		return -EINVAL;
+	/* the transfers use the counters with the adapter locked */
+	if (val) {
+		stats = devm_kzalloc(adapter->dev.parent, sizeof(*stats),
+				     GFP_KERNEL);
+		if (!stats)
+			return -ENOMEM;
+	}
+	i2c_lock_adapter(adapter);
+	swap(stats, iic_stm->stats);
+	i2c_unlock_adapter(adapter);
+	if (stats)
+		devm_kfree(adapter->dev.parent, stats);
+	return count;
+}
+
+static DEVICE_ATTR(latency, S_IRUGO | S_IWUSR, iic_bus_show_latency,
+		   iic_bus_store_latency);
+
 static int __init iic_stm_probe(struct platform_device *pdev)
 {
 	struct stm_plat_ssc_data *plat_data = pdev->dev.platform_data;
@@ -1280,6 +1448,12 @@ static int __init iic_stm_probe(struct platform_device *pdev)
 		return err;
 	}
 
+	err = device_create_file(&(i2c_stm->adapter.dev), &dev_attr_latency);
+	if (err) {
+		dev_err(&pdev->dev, "Cannot create latency sysfs entry\n");
+		return err;
+	}
+
 	/* by default the device is on */
 	pm_runtime_set_active(&pdev->dev);
 	pm_suspend_ignore_children(&pdev->dev, 1);
@@ -1295,6 +1469,7 @@ static int iic_stm_remove(struct platform_device *pdev)
 
 	clk_disable(iic_stm->clk);
 
+	device_remove_file(&iic_stm->adapter.dev, &dev_attr_latency);
 	i2c_del_adapter(&iic_stm->adapter);
 	/* irq */
 	res = platform_get_resource(pdev, IORESOURCE_IRQ, 0);
@@ -1302,6 +1477,8 @@ static int iic_stm_remove(struct platform_device *pdev)
 	/* mem */
 	devm_iounmap(&pdev->dev, iic_stm->base);
 	/* kmem */
+	if (iic_stm->stats)
+		devm_kfree(&pdev->dev, iic_stm->stats);
 	devm_kfree(&pdev->dev, iic_stm);
 	return 0;
 }
@@ -34,6 +34,10 @@
 #include <linux/hardirq.h>
 #include <linux/irqflags.h>
 #include <linux/rwsem.h>
+#include <linux/debugfs.h>
+#include <linux/percpu.h>
+#include <linux/ktime.h>
+#include <linux/wait.h>
 #include <asm/uaccess.h>
 
 #include "i2c-core.h"
@@ -1072,10 +1076,208 @@ module_exit(i2c_exit);
  * Note that there is no requirement that each message be sent to
  * the same slave address, although that is the most common model.
  */
+#ifdef CONFIG_DEBUG_FS
+
+/*
+ * I2C transaction trace
+ *
+ * Every message passed to the bus driver is recorded into a per-CPU ring,
+ * the writer only disables the interrupts on the local CPU. The records
+ * are read as a binary stream of struct i2c_trace_rec from
+ * <debugfs>/i2c/trace (axehelper i2c_decoder --bin), the tracing is
+ * switched on by writing 1 to <debugfs>/i2c/trace_enable.
+ */
+
+#define I2C_TRACE_RECS	1024	/* per CPU, power of two */
+#define I2C_TRACE_DATA	12
+
+struct i2c_trace_rec {
+	u64 ts;			/* transfer start, ktime in ns */
+	u32 seq;		/* sequence number (orders the CPUs) */
+	u32 dur;		/* transfer duration in ns */
+	u16 addr;
+	u16 flags;
+	u16 len;
+	s16 result;		/* master_xfer() result */
+	u8 adap;		/* adapter number */
+	u8 msg;			/* message index in the transfer */
+	u8 nmsgs;
+	u8 cpu;
+	u8 data[I2C_TRACE_DATA];
+};
+
+struct i2c_trace_ring {
+	unsigned int head;	/* records written */
+	struct i2c_trace_rec rec[I2C_TRACE_RECS];
+};
+
+static struct i2c_trace_ring *i2c_trace_rings;
+static u32 i2c_trace_enable;
+static atomic_t i2c_trace_seq = ATOMIC_INIT(0);
+static DECLARE_WAIT_QUEUE_HEAD(i2c_trace_wait);
+
+static void i2c_trace(struct i2c_adapter *adap, struct i2c_msg *msgs, int num,
+		      ktime_t start, int ret)
+{
+	struct i2c_trace_ring *ring;
+	struct i2c_trace_rec *r;
+	unsigned long flags;
+	u32 dur = ktime_to_ns(ktime_sub(ktime_get(), start));
+	int i, cpu;
+
+	if (!i2c_trace_rings)
+		return;
+	local_irq_save(flags);
+	cpu = smp_processor_id();
+	ring = per_cpu_ptr(i2c_trace_rings, cpu);
+	for (i = 0; i < num; i++) {
+		r = &ring->rec[ring->head & (I2C_TRACE_RECS - 1)];
+		r->ts = ktime_to_ns(start);
+		r->seq = atomic_inc_return(&i2c_trace_seq);
+		r->dur = dur;
+		r->addr = msgs[i].addr;
+		r->flags = msgs[i].flags;
+		r->len = msgs[i].len;
+		r->result = ret;
+		r->adap = adap->nr;
+		r->msg = i;
+		r->nmsgs = num;
+		r->cpu = cpu;
+		memcpy(r->data, msgs[i].buf, min_t(int, msgs[i].len, I2C_TRACE_DATA));
+		smp_wmb();
+		ring->head++;
+	}
+	local_irq_restore(flags);
+	if (waitqueue_active(&i2c_trace_wait))
+		wake_up_interruptible(&i2c_trace_wait);
+}
+
+/* per reader: the next record to read for every CPU */
+struct i2c_trace_reader {
+	unsigned int tail[NR_CPUS];
+};
+
+static int i2c_trace_next(struct i2c_trace_reader *rd)
+{
+	struct i2c_trace_ring *ring;
+	unsigned int head;
+	int cpu, best = -1;
+	u32 seq = 0;
+
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(i2c_trace_rings, cpu);
+		head = ACCESS_ONCE(ring->head);
+		if (head - rd->tail[cpu] > I2C_TRACE_RECS)
+			rd->tail[cpu] = head - I2C_TRACE_RECS;	/* overrun */
+		if (head == rd->tail[cpu])
+			continue;
+		smp_rmb();
+		if (best < 0 || (s32)(ring->rec[rd->tail[cpu] & (I2C_TRACE_RECS - 1)].seq - seq) < 0) {
+			best = cpu;
+			seq = ring->rec[rd->tail[cpu] & (I2C_TRACE_RECS - 1)].seq;
+		}
+	}
+	return best;
+}
+
+static int i2c_trace_open(struct inode *inode, struct file *file)
+{
+	struct i2c_trace_reader *rd;
+	struct i2c_trace_ring *ring;
+	int cpu;
+
+	if (!i2c_trace_rings)
+		return -ENOMEM;
+	rd = kzalloc(sizeof(*rd), GFP_KERNEL);
+	if (!rd)
+		return -ENOMEM;
+	/* start with the oldest record still in the rings */
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(i2c_trace_rings, cpu);
+		rd->tail[cpu] = ring->head > I2C_TRACE_RECS ? ring->head - I2C_TRACE_RECS : 0;
+	}
+	file->private_data = rd;
+	return 0;
+}
+
+static int i2c_trace_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+static ssize_t i2c_trace_read(struct file *file, char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	struct i2c_trace_reader *rd = file->private_data;
+	struct i2c_trace_ring *ring;
+	struct i2c_trace_rec rec;
+	ssize_t done = 0;
+	int cpu;
+
+	if (count < sizeof(rec))
+		return -EINVAL;
+	while (count - done >= sizeof(rec)) {
+		cpu = i2c_trace_next(rd);
+		if (cpu < 0) {
+			if (done || (file->f_flags & O_NONBLOCK))
+				break;
+			if (wait_event_interruptible(i2c_trace_wait, i2c_trace_next(rd) >= 0))
+				return -ERESTARTSYS;
+			continue;
+		}
+		ring = per_cpu_ptr(i2c_trace_rings, cpu);
+		rec = ring->rec[rd->tail[cpu] & (I2C_TRACE_RECS - 1)];
+		smp_rmb();
+		/* the writer wrapped around while copying, resync */
+		if (ACCESS_ONCE(ring->head) - rd->tail[cpu] > I2C_TRACE_RECS)
+			continue;
+		rd->tail[cpu]++;
+		if (copy_to_user(buf + done, &rec, sizeof(rec)))
+			return -EFAULT;
+		done += sizeof(rec);
+	}
+	*ppos += done;
+	return done;
+}
+
+static const struct file_operations i2c_trace_fops = {
+	.owner		= THIS_MODULE,
+	.open		= i2c_trace_open,
+	.read		= i2c_trace_read,
+	.release	= i2c_trace_release,
+};
+
+static int __init i2c_trace_init(void)
+{
+	struct dentry *dir;
+
+	i2c_trace_rings = alloc_percpu(struct i2c_trace_ring);
+	if (!i2c_trace_rings)
+		return -ENOMEM;
+	dir = debugfs_create_dir("i2c", NULL);
+	if (!dir || IS_ERR(dir))
+		return 0;
+	debugfs_create_u32("trace_enable", 0644, dir, &i2c_trace_enable);
+	debugfs_create_file("trace", 0400, dir, NULL, &i2c_trace_fops);
+	return 0;
+}
+late_initcall(i2c_trace_init);
+
+#define i2c_trace_on()	unlikely(i2c_trace_enable)
+
+#else
+
+#define i2c_trace_on()	0
+#define i2c_trace(adap, msgs, num, start, ret) do { } while (0)
+
+#endif /* CONFIG_DEBUG_FS */
+
 int i2c_transfer2(struct i2c_adapter *adap, struct i2c_msg *msgs, int num)
 {
 	unsigned long orig_jiffies;
-	int ret, try;
+	ktime_t start = { .tv64 = 0 };
+	int ret, try, trace;
 
 	/* REVISIT the fault reporting model here is weak:
 	 *
@@ -1113,6 +1315,11 @@ int i2c_transfer2(struct i2c_adapter *adap, struct i2c_msg *msgs, int num)
 			mutex_lock_nested(&adap->bus_lock, adap->level);
 		}
 
+		/* latched, the trace may be switched while the transfer runs */
+		trace = i2c_trace_on();
+		if (trace)
+			start = ktime_get();
+
 		/* Retry automatically on arbitration loss */
 		orig_jiffies = jiffies;
 		for (ret = 0, try = 0; try <= adap->retries; try++) {
@@ -1124,6 +1331,9 @@ int i2c_transfer2(struct i2c_adapter *adap, struct i2c_msg *msgs, int num)
 		}
 		mutex_unlock(&adap->bus_lock);
 
+		if (trace)
+			i2c_trace(adap, msgs, num, start, ret);
+
 		return ret;
 	} else {
 		dev_dbg(&adap->dev, "I2C level transfers not supported\n");
@@ -94,6 +94,11 @@ struct stmmac_extra_stats {
 	unsigned long rx_pkt_n;
 	unsigned long poll_n;
 	unsigned long sched_timer_n;
+	unsigned long tx_reset_ic_bit;
+	unsigned long tx_coal_timer_n;
+	unsigned long rx_pool_empty;
+	unsigned long rx_pool_alloc_fail;
+	unsigned long rx_copybreak_n;
 	unsigned long normal_irq_n;
 	unsigned long mmc_tx_irq_n;
 	unsigned long mmc_rx_irq_n;
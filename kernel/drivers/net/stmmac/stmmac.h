@@ -30,6 +30,30 @@
 #include "stmmac_timer.h"
 #endif
 
+#ifdef CONFIG_STMMAC_DEBUG_FS
+/* Frame length buckets: <=64, 65-127, 128-255, 256-511, 512-1023,
+ * 1024-1518, >1518 */
+#define STMMAC_LEN_BUCKETS	7
+
+/* Ring and buffer counters reported by debugfs (stmmaceth/stats) */
+struct stmmac_fs_stats {
+	unsigned int tx_ring_max;	/* TX descriptors in use, high-water */
+	unsigned int rx_dirty_max;	/* RX descriptors to refill, high-water */
+	unsigned long tx_queue_stop;	/* queue stopped, ring full */
+	unsigned long tx_queue_wake;
+	unsigned long tx_busy;		/* NETDEV_TX_BUSY returned */
+	unsigned long tx_hard_error;
+	unsigned long tc_bump;		/* DMA threshold raised */
+	unsigned long tx_recycle;	/* skb_recycle_check hits */
+	unsigned long tx_recycle_miss;
+	unsigned long rx_recycle;	/* refill from the recycle queue */
+	unsigned long rx_alloc;		/* refill with a new skb */
+	unsigned long rx_refill_fail;
+	unsigned long tx_len[STMMAC_LEN_BUCKETS];
+	unsigned long rx_len[STMMAC_LEN_BUCKETS];
+};
+#endif
+
 struct stmmac_priv {
 	/* Frequently used values are kept adjacent for cache effect */
 	struct dma_desc *dma_tx ____cacheline_aligned;
@@ -38,7 +62,7 @@ struct stmmac_priv {
 	unsigned int cur_tx;
 	unsigned int dirty_tx;
 	unsigned int dma_tx_size;
-	int tx_coalesce;
+	unsigned int tx_count_frames;
 
 	struct dma_desc *dma_rx ;
 	unsigned int cur_rx;
@@ -46,6 +70,8 @@ struct stmmac_priv {
 	struct sk_buff **rx_skbuff;
 	dma_addr_t *rx_skbuff_dma;
 	struct sk_buff_head rx_recycle;
+	unsigned int rx_pool_size;
+	struct work_struct rx_pool_work;
 
 	struct net_device *dev;
 	dma_addr_t dma_rx_phy;
@@ -91,8 +117,46 @@ struct stmmac_priv {
 	int lpi_irq;
 	int phy_wol_plus;
 	u32 lpi_ctl_status;
+	unsigned int tx_coal_frames;
+	unsigned int tx_coal_usecs;
+	struct timer_list tx_coal_timer;
+#ifdef CONFIG_STMMAC_DEBUG_FS
+	struct stmmac_fs_stats fs_stats;
+#endif
 };
 
+#ifdef CONFIG_STMMAC_DEBUG_FS
+static inline int stmmac_len_bucket(unsigned int len)
+{
+	if (len <= 64)
+		return 0;
+	if (len > ETH_FRAME_LEN + ETH_FCS_LEN)
+		return STMMAC_LEN_BUCKETS - 1;
+	return fls(len) - 6;
+}
+
+#define STMMAC_FS_INC(p, m)	((p)->fs_stats.m++)
+#define STMMAC_FS_MAX(p, m, v)				\
+	do {						\
+		if ((v) > (p)->fs_stats.m)		\
+			(p)->fs_stats.m = (v);		\
+	} while (0)
+#define STMMAC_FS_LEN(p, m, len)			\
+	((p)->fs_stats.m[stmmac_len_bucket(len)]++)
+#else
+#define STMMAC_FS_INC(p, m)		do { } while (0)
+#define STMMAC_FS_MAX(p, m, v)		do { } while (0)
+#define STMMAC_FS_LEN(p, m, len)	do { } while (0)
+#endif
+
+/* TX completion mitigation: the IC bit is only set once every
+ * tx_coal_frames descriptors, the timer reclaims the others. */
+#define STMMAC_TX_COAL_FRAMES		32
+#define STMMAC_TX_COAL_MAX_FRAMES	128
+#define STMMAC_TX_COAL_USECS		1000
+#define STMMAC_TX_COAL_MAX_USECS	100000
+#define STMMAC_TX_COAL_TIMER(x)	(jiffies + usecs_to_jiffies(x))
+
 extern int phyaddr;
 
 extern int stmmac_mdio_unregister(struct net_device *ndev);
@@ -90,6 +90,11 @@ static const struct stmmac_stats stmmac_gstrings_stats[] = {
 	STMMAC_STAT(rx_pkt_n),
 	STMMAC_STAT(poll_n),
 	STMMAC_STAT(sched_timer_n),
+	STMMAC_STAT(tx_reset_ic_bit),
+	STMMAC_STAT(tx_coal_timer_n),
+	STMMAC_STAT(rx_pool_empty),
+	STMMAC_STAT(rx_pool_alloc_fail),
+	STMMAC_STAT(rx_copybreak_n),
 	STMMAC_STAT(normal_irq_n),
 	STMMAC_STAT(normal_irq_n),
 	STMMAC_STAT(mmc_tx_irq_n),
@@ -527,6 +532,65 @@ static int ethtool_op_set_eee(struct net_device *dev, struct ethtool_value *eee)
 	return 0;
 }
 
+static int stmmac_get_coalesce(struct net_device *dev,
+			       struct ethtool_coalesce *ec)
+{
+	struct stmmac_priv *priv = netdev_priv(dev);
+
+	ec->tx_coalesce_usecs = priv->tx_coal_usecs;
+	ec->tx_max_coalesced_frames = priv->tx_coal_frames;
+#ifdef CONFIG_STMMAC_TIMER
+	/* The RX interrupts are mitigated only by the external timer */
+	if (netif_running(dev) && priv->tm->enable && priv->tm->freq)
+		ec->rx_coalesce_usecs = USEC_PER_SEC / priv->tm->freq;
+#endif
+
+	return 0;
+}
+
+static int stmmac_set_coalesce(struct net_device *dev,
+			       struct ethtool_coalesce *ec)
+{
+	struct stmmac_priv *priv = netdev_priv(dev);
+	struct ethtool_coalesce cur;
+
+	if ((ec->tx_max_coalesced_frames > STMMAC_TX_COAL_MAX_FRAMES) ||
+	    ((priv->dma_tx_size) &&
+	     (ec->tx_max_coalesced_frames > priv->dma_tx_size / 4)))
+		return -EINVAL;
+
+	/* Without the timer the last frames would never be reclaimed */
+	if ((ec->tx_max_coalesced_frames > 1) &&
+	    ((!ec->tx_coalesce_usecs) ||
+	     (ec->tx_coalesce_usecs > STMMAC_TX_COAL_MAX_USECS)))
+		return -EINVAL;
+
+	memset(&cur, 0, sizeof(cur));
+	stmmac_get_coalesce(dev, &cur);
+	if (ec->rx_coalesce_usecs != cur.rx_coalesce_usecs) {
+#ifdef CONFIG_STMMAC_TIMER
+		/* The new rate is used from the next poll; it is reset
+		 * to tmrate when the interface is opened again. */
+		if (!cur.rx_coalesce_usecs)
+			return -EOPNOTSUPP;
+		if ((!ec->rx_coalesce_usecs) ||
+		    (ec->rx_coalesce_usecs > USEC_PER_SEC))
+			return -EINVAL;
+		priv->tm->freq = USEC_PER_SEC / ec->rx_coalesce_usecs;
+#else
+		return -EOPNOTSUPP;
+#endif
+	}
+
+	spin_lock_bh(&priv->tx_lock);
+	priv->tx_coal_frames = ec->tx_max_coalesced_frames;
+	priv->tx_coal_usecs = ec->tx_coalesce_usecs;
+	priv->tx_count_frames = 0;
+	spin_unlock_bh(&priv->tx_lock);
+
+	return 0;
+}
+
 static int stmmac_ethtool_begin(struct net_device *netdev)
 {
 	struct stmmac_priv *priv = netdev_priv(netdev);
@@ -568,6 +632,8 @@ static struct ethtool_ops stmmac_ethtool_ops = {
 	.set_tso = ethtool_op_set_tso,
 	.get_eee = ethtool_op_get_eee,
 	.set_eee = ethtool_op_set_eee,
+	.get_coalesce = stmmac_get_coalesce,
+	.set_coalesce = stmmac_set_coalesce,
 	.begin = stmmac_ethtool_begin,
 	.complete = stmmac_ethtool_complete,
 };
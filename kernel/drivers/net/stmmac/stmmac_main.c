@@ -40,6 +40,7 @@
 #include <linux/if_vlan.h>
 #include <linux/dma-mapping.h>
 #include <linux/prefetch.h>
+#include <linux/workqueue.h>
 #ifdef CONFIG_STMMAC_DEBUG_FS
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
@@ -127,6 +128,28 @@ static int buf_sz = DMA_BUFFER_SIZE;
 module_param(buf_sz, int, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(buf_sz, "DMA buffer size");
 
+static int tx_coal_frames = STMMAC_TX_COAL_FRAMES;
+module_param(tx_coal_frames, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(tx_coal_frames, "TX frames per completion interrupt");
+
+static int tx_coal_usecs = STMMAC_TX_COAL_USECS;
+module_param(tx_coal_usecs, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(tx_coal_usecs, "TX completion timer in usec");
+
+/* RX buffers kept preallocated for the refill, topped up by a work
+ * (GFP_KERNEL) so that the NAPI poll does not allocate them. */
+#define RX_POOL_SIZE	128
+static int rx_pool = RX_POOL_SIZE;
+module_param(rx_pool, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rx_pool, "Number of preallocated RX buffers");
+
+/* Frames shorter than this are copied and the DMA buffer stays
+ * in the ring */
+#define RX_COPYBREAK	256
+static int rx_copybreak = RX_COPYBREAK;
+module_param(rx_copybreak, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rx_copybreak, "Copy RX frames shorter than this");
+
 static const u32 default_msg_level = (NETIF_MSG_DRV | NETIF_MSG_PROBE |
 				      NETIF_MSG_LINK | NETIF_MSG_IFUP |
 				      NETIF_MSG_IFDOWN | NETIF_MSG_TIMER);
@@ -171,6 +194,16 @@ static void stmmac_verify_args(void)
 		flow_ctrl = FLOW_OFF;
 	if (unlikely((pause < 0) || (pause > 0xffff)))
 		pause = PAUSE_TIME;
+	if (unlikely((tx_coal_frames < 0) ||
+		     (tx_coal_frames > STMMAC_TX_COAL_MAX_FRAMES)))
+		tx_coal_frames = STMMAC_TX_COAL_FRAMES;
+	if (unlikely((tx_coal_usecs <= 0) ||
+		     (tx_coal_usecs > STMMAC_TX_COAL_MAX_USECS)))
+		tx_coal_usecs = STMMAC_TX_COAL_USECS;
+	if (unlikely(rx_pool < 0))
+		rx_pool = RX_POOL_SIZE;
+	if (unlikely(rx_copybreak < 0))
+		rx_copybreak = RX_COPYBREAK;
 }
 
 #if defined(STMMAC_XMIT_DEBUG) || defined(STMMAC_RX_DEBUG)
@@ -724,10 +757,13 @@ static void stmmac_tx(struct stmmac_priv *priv)
 			 */
 			if ((skb_queue_len(&priv->rx_recycle) <
 				priv->dma_rx_size) &&
-				skb_recycle_check(skb, priv->dma_buf_sz))
-				__skb_queue_head(&priv->rx_recycle, skb);
-			else
+				skb_recycle_check(skb, priv->dma_buf_sz)) {
+				skb_queue_head(&priv->rx_recycle, skb);
+				STMMAC_FS_INC(priv, tx_recycle);
+			} else {
 				dev_kfree_skb(skb);
+				STMMAC_FS_INC(priv, tx_recycle_miss);
+			}
 
 			priv->tx_skbuff[entry] = NULL;
 		}
@@ -743,6 +779,7 @@ static void stmmac_tx(struct stmmac_priv *priv)
 		     stmmac_tx_avail(priv) > STMMAC_TX_THRESH(priv)) {
 			TX_DBG("%s: restart transmit\n", __func__);
 			netif_wake_queue(priv->dev);
+			STMMAC_FS_INC(priv, tx_queue_wake);
 		}
 		netif_tx_unlock(priv->dev);
 	}
@@ -754,11 +791,87 @@ static void stmmac_tx(struct stmmac_priv *priv)
 	spin_unlock(&priv->tx_lock);
 }
 
+/**
+ * stmmac_tx_coal_timer:
+ * @arg : data hook
+ * Description: it reclaims the TX descriptors transmitted without
+ * raising the completion interrupt (see stmmac_tx_coalesce).
+ * The timer is re-armed while some frames are still in flight.
+ */
+static void stmmac_tx_coal_timer(unsigned long arg)
+{
+	struct stmmac_priv *priv = (struct stmmac_priv *)arg;
+
+	priv->xstats.tx_coal_timer_n++;
+	stmmac_tx(priv);
+
+	if (priv->dirty_tx != priv->cur_tx)
+		mod_timer(&priv->tx_coal_timer,
+			  STMMAC_TX_COAL_TIMER(priv->tx_coal_usecs));
+}
+
+/**
+ * stmmac_tx_coalesce:
+ * @priv: private driver structure
+ * @desc: last descriptor of the frame
+ * @count: number of descriptors used by the frame
+ * Description: it clears the IC bit of the frame unless tx_coal_frames
+ * descriptors have been queued since the last interrupt on completion.
+ * Called with the tx_lock held.
+ */
+static inline void stmmac_tx_coalesce(struct stmmac_priv *priv,
+				      struct dma_desc *desc, int count)
+{
+	if (priv->tx_coal_frames <= 1)
+		return;
+
+	priv->tx_count_frames += count;
+	if (priv->tx_count_frames < priv->tx_coal_frames) {
+		priv->hw->desc->clear_tx_ic(desc);
+		priv->xstats.tx_reset_ic_bit++;
+		if (!timer_pending(&priv->tx_coal_timer))
+			mod_timer(&priv->tx_coal_timer,
+				  STMMAC_TX_COAL_TIMER(priv->tx_coal_usecs));
+	} else
+		priv->tx_count_frames = 0;
+}
+
+/**
+ * stmmac_rx_pool_fill:
+ * @priv: private driver structure
+ * @gfp: allocation flags
+ * Description: it tops up the RX buffer pool (rx_recycle) to rx_pool_size
+ * skbs. The pool is shared with the TX skbs recycled in stmmac_tx.
+ */
+static void stmmac_rx_pool_fill(struct stmmac_priv *priv, gfp_t gfp)
+{
+	struct sk_buff *skb;
+
+	while (skb_queue_len(&priv->rx_recycle) < priv->rx_pool_size) {
+		skb = __netdev_alloc_skb(priv->dev,
+					 priv->dma_buf_sz + NET_IP_ALIGN, gfp);
+		if (unlikely(skb == NULL)) {
+			priv->xstats.rx_pool_alloc_fail++;
+			break;
+		}
+		skb_reserve(skb, NET_IP_ALIGN);
+		skb_queue_tail(&priv->rx_recycle, skb);
+	}
+}
+
+static void stmmac_rx_pool_work(struct work_struct *work)
+{
+	struct stmmac_priv *priv = container_of(work, struct stmmac_priv,
+						rx_pool_work);
+
+	stmmac_rx_pool_fill(priv, GFP_KERNEL);
+}
+
 static inline void stmmac_enable_irq(struct stmmac_priv *priv)
 {
 #ifdef CONFIG_STMMAC_TIMER
 	if (likely(priv->tm->enable))
-		priv->tm->timer_start(priv->tm->timer_callb, tmrate);
+		priv->tm->timer_start(priv->tm->timer_callb, priv->tm->freq);
 	else
 #endif
 		priv->hw->dma->enable_dma_irq(priv->ioaddr);
@@ -835,6 +948,7 @@ static void stmmac_tx_err(struct stmmac_priv *priv)
 	priv->hw->desc->init_tx_desc(priv->dma_tx, priv->dma_tx_size);
 	priv->dirty_tx = 0;
 	priv->cur_tx = 0;
+	priv->tx_count_frames = 0;
 	priv->hw->dma->start_tx(priv->ioaddr);
 
 	priv->dev->stats.tx_errors++;
@@ -856,9 +970,12 @@ static void stmmac_dma_interrupt(struct stmmac_priv *priv)
 			tc += 64;
 			priv->hw->dma->dma_mode(priv->ioaddr, tc, SF_DMA_MODE);
 			priv->xstats.threshold = tc;
+			STMMAC_FS_INC(priv, tc_bump);
 		}
-	} else if (unlikely(status == tx_hard_error))
+	} else if (unlikely(status == tx_hard_error)) {
+		STMMAC_FS_INC(priv, tx_hard_error);
 		stmmac_tx_err(priv);
+	}
 }
 
 static void stmmac_mmc_setup(struct stmmac_priv *priv)
@@ -1000,7 +1117,7 @@ static int _stmmac_open(struct net_device *dev, bool resuming)
 	/* MDIO bus Registration */
 
 #ifdef CONFIG_STMMAC_TIMER
-	priv->tm = kzalloc(sizeof(struct stmmac_timer *), GFP_KERNEL);
+	priv->tm = kzalloc(sizeof(struct stmmac_timer), GFP_KERNEL);
 	if (unlikely(priv->tm == NULL)) {
 		pr_err("%s: ERROR: timer memory alloc failed\n", __func__);
 		return -ENOMEM;
@@ -1030,6 +1147,11 @@ static int _stmmac_open(struct net_device *dev, bool resuming)
 	priv->dma_buf_sz = STMMAC_ALIGN(buf_sz);
 	init_dma_desc_rings(dev);
 
+	/* Keep an interrupt on completion before the queue can be stopped */
+	if (priv->tx_coal_frames > STMMAC_TX_THRESH(priv))
+		priv->tx_coal_frames = STMMAC_TX_THRESH(priv);
+	priv->tx_count_frames = 0;
+
 	/* DMA initialization and SW reset */
 	ret = priv->hw->dma->init(priv->ioaddr, priv->plat->pbl,
 				  priv->dma_tx_phy, priv->dma_rx_phy);
@@ -1088,6 +1210,9 @@ static int _stmmac_open(struct net_device *dev, bool resuming)
 	/* Extra statistics */
 	memset(&priv->xstats, 0, sizeof(struct stmmac_extra_stats));
 	priv->xstats.threshold = tc;
+#ifdef CONFIG_STMMAC_DEBUG_FS
+	memset(&priv->fs_stats, 0, sizeof(struct stmmac_fs_stats));
+#endif
 
 	stmmac_mmc_setup(priv);
 
@@ -1096,6 +1221,11 @@ static int _stmmac_open(struct net_device *dev, bool resuming)
 	if (ret < 0)
 		pr_warning("%s: failed debugFS registration\n", __func__);
 #endif
+	/* Preallocate the RX buffers before starting the DMA */
+	skb_queue_head_init(&priv->rx_recycle);
+	priv->rx_pool_size = min_t(unsigned int, rx_pool, priv->dma_rx_size);
+	stmmac_rx_pool_fill(priv, GFP_KERNEL);
+
 	/* Start the ball rolling... */
 	DBG(probe, DEBUG, "%s: DMA RX/TX processes started...\n", dev->name);
 	priv->hw->dma->start_tx(priv->ioaddr);
@@ -1103,7 +1233,7 @@ static int _stmmac_open(struct net_device *dev, bool resuming)
 
 #ifdef CONFIG_STMMAC_TIMER
 	if (likely(priv->tm->enable))
-		priv->tm->timer_start(priv->tm->timer_callb, tmrate);
+		priv->tm->timer_start(priv->tm->timer_callb, priv->tm->freq);
 #endif
 
 	/* Dump DMA/MAC registers */
@@ -1121,7 +1251,6 @@ static int _stmmac_open(struct net_device *dev, bool resuming)
 		pm_runtime_put(priv->device);
 
 	napi_enable(&priv->napi);
-	skb_queue_head_init(&priv->rx_recycle);
 	netif_start_queue(dev);
 
 	return 0;
@@ -1186,6 +1315,8 @@ static int _stmmac_release(struct net_device *dev, bool suspending)
 		kfree(priv->tm);
 #endif
 	napi_disable(&priv->napi);
+	del_timer_sync(&priv->tx_coal_timer);
+	cancel_work_sync(&priv->rx_pool_work);
 	skb_queue_purge(&priv->rx_recycle);
 
 	/* Free the IRQ lines */
@@ -1240,8 +1371,10 @@ static int stmmac_sw_tso(struct stmmac_priv *priv, struct sk_buff *skb)
 		netif_stop_queue(priv->dev);
 		TX_DBG(KERN_ERR "%s: TSO BUG! Tx Ring full when queue awake\n",
 		       __func__);
-		if (stmmac_tx_avail(priv) < gso_segs)
+		if (stmmac_tx_avail(priv) < gso_segs) {
+			STMMAC_FS_INC(priv, tx_busy);
 			return NETDEV_TX_BUSY;
+		}
 
 		netif_wake_queue(priv->dev);
 	}
@@ -1290,6 +1423,7 @@ static netdev_tx_t stmmac_xmit(struct sk_buff *skb, struct net_device *dev)
 			pr_err("%s: BUG! Tx Ring full when queue awake\n",
 				__func__);
 		}
+		STMMAC_FS_INC(priv, tx_busy);
 		return NETDEV_TX_BUSY;
 	}
 
@@ -1365,7 +1499,9 @@ static netdev_tx_t stmmac_xmit(struct sk_buff *skb, struct net_device *dev)
 	/* Clean IC while using timer */
 	if (likely(priv->tm->enable))
 		priv->hw->desc->clear_tx_ic(desc);
+	else
 #endif
+		stmmac_tx_coalesce(priv, desc, nfrags + 1);
 
 	wmb();
 
@@ -1374,6 +1510,9 @@ static netdev_tx_t stmmac_xmit(struct sk_buff *skb, struct net_device *dev)
 
 	priv->cur_tx++;
 
+	STMMAC_FS_MAX(priv, tx_ring_max, priv->cur_tx - priv->dirty_tx);
+	STMMAC_FS_LEN(priv, tx_len, skb->len);
+
 #ifdef STMMAC_XMIT_DEBUG
 	if (netif_msg_pktdata(priv)) {
 		pr_info("stmmac xmit: current=%d, dirty=%d, entry=%d, "
@@ -1388,6 +1527,7 @@ static netdev_tx_t stmmac_xmit(struct sk_buff *skb, struct net_device *dev)
 	if (unlikely(stmmac_tx_avail(priv) <= (MAX_SKB_FRAGS + 1))) {
 		TX_DBG("%s: stop transmitted packets\n", __func__);
 		netif_stop_queue(dev);
+		STMMAC_FS_INC(priv, tx_queue_stop);
 	}
 
 	dev->stats.tx_bytes += skb->len;
@@ -1405,18 +1545,26 @@ static inline void stmmac_rx_refill(struct stmmac_priv *priv)
 	int bfsize = priv->dma_buf_sz;
 	struct dma_desc *p = priv->dma_rx;
 
+	STMMAC_FS_MAX(priv, rx_dirty_max, priv->cur_rx - priv->dirty_rx);
+
 	for (; priv->cur_rx - priv->dirty_rx > 0; priv->dirty_rx++) {
 		unsigned int entry = priv->dirty_rx % rxsize;
 		if (likely(priv->rx_skbuff[entry] == NULL)) {
 			struct sk_buff *skb;
 
-			skb = __skb_dequeue(&priv->rx_recycle);
-			if (skb == NULL)
+			skb = skb_dequeue(&priv->rx_recycle);
+			if (skb == NULL) {
+				priv->xstats.rx_pool_empty++;
 				skb = netdev_alloc_skb_ip_align(priv->dev,
 								bfsize);
+				STMMAC_FS_INC(priv, rx_alloc);
+			} else
+				STMMAC_FS_INC(priv, rx_recycle);
 
-			if (unlikely(skb == NULL))
+			if (unlikely(skb == NULL)) {
+				STMMAC_FS_INC(priv, rx_refill_fail);
 				break;
+			}
 
 			priv->rx_skbuff[entry] = skb;
 			priv->rx_skbuff_dma[entry] =
@@ -1433,6 +1581,38 @@ static inline void stmmac_rx_refill(struct stmmac_priv *priv)
 		wmb();
 		priv->hw->desc->set_rx_owner(p + entry);
 	}
+
+	if (skb_queue_len(&priv->rx_recycle) < priv->rx_pool_size / 2)
+		schedule_work(&priv->rx_pool_work);
+}
+
+/**
+ * stmmac_rx_copybreak:
+ * @priv: private driver structure
+ * @entry: RX descriptor index
+ * @len: frame length
+ * Description: it copies a short frame to a new skb, the DMA buffer
+ * is left in the ring and given back to the DMA by stmmac_rx_refill.
+ * Return value: the new skb or NULL.
+ */
+static struct sk_buff *stmmac_rx_copybreak(struct stmmac_priv *priv,
+					   unsigned int entry, int len)
+{
+	struct sk_buff *skb;
+
+	skb = netdev_alloc_skb_ip_align(priv->dev, len);
+	if (unlikely(skb == NULL))
+		return NULL;
+
+	dma_sync_single_for_cpu(priv->device, priv->rx_skbuff_dma[entry],
+				len, DMA_FROM_DEVICE);
+	skb_copy_to_linear_data(skb, priv->rx_skbuff[entry]->data, len);
+	dma_sync_single_for_device(priv->device, priv->rx_skbuff_dma[entry],
+				   len, DMA_FROM_DEVICE);
+	skb_put(skb, len);
+	priv->xstats.rx_copybreak_n++;
+
+	return skb;
 }
 
 static int stmmac_rx(struct stmmac_priv *priv, int limit)
@@ -1465,7 +1645,7 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit)
 		if (unlikely(status == discard_frame))
 			priv->dev->stats.rx_errors++;
 		else {
-			struct sk_buff *skb;
+			struct sk_buff *skb, *copy;
 			int frame_len;
 
 			frame_len = priv->hw->desc->get_rx_frame_len(p);
@@ -1489,13 +1669,25 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit)
 				priv->dev->stats.rx_dropped++;
 				break;
 			}
-			prefetch(skb->data - NET_IP_ALIGN);
-			priv->rx_skbuff[entry] = NULL;
+			if (frame_len < rx_copybreak)
+				copy = stmmac_rx_copybreak(priv, entry,
+							   frame_len);
+			else
+				copy = NULL;
 
-			skb_put(skb, frame_len);
-			dma_unmap_single(priv->device,
-					 priv->rx_skbuff_dma[entry],
-					 priv->dma_buf_sz, DMA_FROM_DEVICE);
+			if (copy) {
+				/* the DMA buffer stays in the ring */
+				skb = copy;
+			} else {
+				prefetch(skb->data - NET_IP_ALIGN);
+				priv->rx_skbuff[entry] = NULL;
+
+				skb_put(skb, frame_len);
+				dma_unmap_single(priv->device,
+						 priv->rx_skbuff_dma[entry],
+						 priv->dma_buf_sz,
+						 DMA_FROM_DEVICE);
+			}
 #ifdef STMMAC_RX_DEBUG
 			if (netif_msg_pktdata(priv)) {
 				pr_info(" frame received (%dbytes)", frame_len);
@@ -1515,6 +1707,7 @@ static int stmmac_rx(struct stmmac_priv *priv, int limit)
 
 			priv->dev->stats.rx_packets++;
 			priv->dev->stats.rx_bytes += frame_len;
+			STMMAC_FS_LEN(priv, rx_len, frame_len);
 			priv->dev->last_rx = jiffies;
 		}
 		entry = next_entry;
@@ -1761,6 +1954,7 @@ static void stmmac_vlan_rx_register(struct net_device *dev,
 static struct dentry *stmmac_fs_dir;
 static struct dentry *stmmac_rings_status;
 static struct dentry *stmmac_dma_cap;
+static struct dentry *stmmac_stats;
 
 static int stmmac_sysfs_ring_read(struct seq_file *seq, void *v)
 {
@@ -1886,6 +2080,81 @@ static const struct file_operations stmmac_dma_cap_fops = {
 	.release = seq_release,
 };
 
+static int stmmac_sysfs_stats_read(struct seq_file *seq, void *v)
+{
+	static const char *len_str[STMMAC_LEN_BUCKETS] = {
+		"<= 64", "65-127", "128-255", "256-511", "512-1023",
+		"1024-1518", "> 1518"
+	};
+	struct net_device *dev = seq->private;
+	struct stmmac_priv *priv = netdev_priv(dev);
+	struct stmmac_fs_stats *s = &priv->fs_stats;
+	int i;
+
+	seq_printf(seq, "==============================\n");
+	seq_printf(seq, "\tTX ring (%d descriptors)\n", priv->dma_tx_size);
+	seq_printf(seq, "==============================\n");
+	seq_printf(seq, "\tin use: %u (max %u)\n",
+		   priv->cur_tx - priv->dirty_tx, s->tx_ring_max);
+	seq_printf(seq, "\tqueue stopped: %lu woken: %lu busy: %lu\n",
+		   s->tx_queue_stop, s->tx_queue_wake, s->tx_busy);
+	seq_printf(seq, "\thard errors: %lu\n", s->tx_hard_error);
+	seq_printf(seq, "\tthreshold: %d (bumped %lu times)\n",
+		   tc, s->tc_bump);
+	seq_printf(seq, "\tskb recycled: %lu not recycled: %lu\n",
+		   s->tx_recycle, s->tx_recycle_miss);
+
+	seq_printf(seq, "==============================\n");
+	seq_printf(seq, "\tRX ring (%d descriptors)\n", priv->dma_rx_size);
+	seq_printf(seq, "==============================\n");
+	seq_printf(seq, "\tto refill: %u (max %u)\n",
+		   priv->cur_rx - priv->dirty_rx, s->rx_dirty_max);
+	seq_printf(seq, "\trefill from recycle: %lu allocated: %lu\n",
+		   s->rx_recycle, s->rx_alloc);
+	seq_printf(seq, "\trefill failures: %lu\n", s->rx_refill_fail);
+	seq_printf(seq, "\tbuffer pool: %u/%u (empty %lu times)\n",
+		   skb_queue_len(&priv->rx_recycle), priv->rx_pool_size,
+		   priv->xstats.rx_pool_empty);
+	seq_printf(seq, "\tcopybreak: %lu\n", priv->xstats.rx_copybreak_n);
+
+	seq_printf(seq, "==============================\n");
+	seq_printf(seq, "\tFrame length\tTX\t\tRX\n");
+	seq_printf(seq, "==============================\n");
+	for (i = 0; i < STMMAC_LEN_BUCKETS; i++)
+		seq_printf(seq, "\t%-9s\t%-10lu\t%lu\n", len_str[i],
+			   s->tx_len[i], s->rx_len[i]);
+
+	return 0;
+}
+
+static int stmmac_sysfs_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, stmmac_sysfs_stats_read, inode->i_private);
+}
+
+/* Any write clears the counters */
+static ssize_t stmmac_sysfs_stats_write(struct file *file,
+					const char __user *buf,
+					size_t count, loff_t *ppos)
+{
+	struct seq_file *seq = file->private_data;
+	struct net_device *dev = seq->private;
+	struct stmmac_priv *priv = netdev_priv(dev);
+
+	memset(&priv->fs_stats, 0, sizeof(struct stmmac_fs_stats));
+
+	return count;
+}
+
+static const struct file_operations stmmac_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = stmmac_sysfs_stats_open,
+	.read = seq_read,
+	.write = stmmac_sysfs_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int stmmac_init_fs(struct net_device *dev)
 {
 	/* Create debugfs entries */
@@ -1922,6 +2191,20 @@ static int stmmac_init_fs(struct net_device *dev)
 		return -ENOMEM;
 	}
 
+	/* Entry to report the ring and buffer counters */
+	stmmac_stats = debugfs_create_file("stats", S_IRUGO | S_IWUSR,
+					   stmmac_fs_dir, dev,
+					   &stmmac_stats_fops);
+
+	if (!stmmac_stats || IS_ERR(stmmac_stats)) {
+		pr_info("ERROR creating stmmac stats debugfs file\n");
+		debugfs_remove(stmmac_dma_cap);
+		debugfs_remove(stmmac_rings_status);
+		debugfs_remove(stmmac_fs_dir);
+
+		return -ENOMEM;
+	}
+
 	return 0;
 }
 
@@ -1929,6 +2212,7 @@ static void stmmac_exit_fs(void)
 {
 	debugfs_remove(stmmac_rings_status);
 	debugfs_remove(stmmac_dma_cap);
+	debugfs_remove(stmmac_stats);
 	debugfs_remove(stmmac_fs_dir);
 }
 #endif /* CONFIG_STMMAC_DEBUG_FS */
@@ -2055,6 +2339,13 @@ struct stmmac_priv *stmmac_dvr_probe(struct device *device,
 	/* Verify driver arguments */
 	stmmac_verify_args();
 
+	priv->tx_coal_frames = tx_coal_frames;
+	priv->tx_coal_usecs = tx_coal_usecs;
+	INIT_WORK(&priv->rx_pool_work, stmmac_rx_pool_work);
+	init_timer(&priv->tx_coal_timer);
+	priv->tx_coal_timer.function = stmmac_tx_coal_timer;
+	priv->tx_coal_timer.data = (unsigned long)priv;
+
 	/* Override with kernel parameters if supplied XXX CRS XXX
 	 * this needs to have multiple instances */
 	if ((phyaddr >= 0) && (phyaddr <= 31))
@@ -2155,6 +2446,7 @@ int stmmac_suspend(struct net_device *ndev)
 		dis_ic = 1;
 #endif
 	napi_disable(&priv->napi);
+	del_timer_sync(&priv->tx_coal_timer);
 
 	/* Stop TX/RX DMA */
 	priv->hw->dma->stop_tx(priv->ioaddr);
@@ -2205,7 +2497,7 @@ int stmmac_resume(struct net_device *ndev)
 
 #ifdef CONFIG_STMMAC_TIMER
 	if (likely(priv->tm->enable))
-		priv->tm->timer_start(priv->tm->timer_callb, tmrate);
+		priv->tm->timer_start(priv->tm->timer_callb, priv->tm->freq);
 #endif
 	napi_enable(&priv->napi);
 
@@ -2281,6 +2573,22 @@ static int __init stmmac_cmdline_opt(char *str)
 			if (strict_strtoul(opt + 12, 0,
 					   (unsigned long *)&wol_plus_en))
 				goto err;
+		} else if (!strncmp(opt, "tx_coal_frames:", 15)) {
+			if (strict_strtoul(opt + 15, 0,
+					   (unsigned long *)&tx_coal_frames))
+				goto err;
+		} else if (!strncmp(opt, "tx_coal_usecs:", 14)) {
+			if (strict_strtoul(opt + 14, 0,
+					   (unsigned long *)&tx_coal_usecs))
+				goto err;
+		} else if (!strncmp(opt, "rx_pool:", 8)) {
+			if (strict_strtoul(opt + 8, 0,
+					   (unsigned long *)&rx_pool))
+				goto err;
+		} else if (!strncmp(opt, "rx_copybreak:", 13)) {
+			if (strict_strtoul(opt + 13, 0,
+					   (unsigned long *)&rx_copybreak))
+				goto err;
 #ifdef CONFIG_STMMAC_TIMER
 		} else if (!strncmp(opt, "tmrate:", 7)) {
 			if (strict_strtoul(opt + 7, 0,
@@ -0,0 +1,480 @@
+/*
+
+TS replay for the AXE adapters - run minisatip on a host without
+the IDL-400s hardware. The /dev/axe/frontend-N and /dev/axe/demuxts-N
+nodes are emulated: the frontends report a synthetic lock/signal and
+the demuxts devices serve a .ts file (paced by PCR or at max speed).
+
+Compile:
+  gcc -o axe-replay.o -c -fPIC -Wall axe-replay.c
+  gcc -o axe-replay.so -shared -rdynamic axe-replay.o -ldl -lpthread
+
+Usage:
+   export LD_PRELOAD=/tmp/axe-replay.so
+   export AXE_REPLAY_FILE=/tmp/mux.ts
+   export AXE_REPLAY_RATE=pcr       # pcr (default) or max
+   export AXE_REPLAY_LOCK_MS=300    # time to lock after a tune
+   export AXE_REPLAY_SNR=80         # 0-100%
+   export AXE_REPLAY_LOG=/tmp/replay.log
+   ..run minisatip7 or minisatip8 (configured with --enable-axe)..
+
+Notes:
+   All demuxts devices serve the complete file (looped), the pid
+   filtering is done in minisatip. Unknown ioctls on the emulated
+   nodes succeed and return zeroed data, except FE_GET_EVENT which
+   fails with EWOULDBLOCK (no event queued) - minisatip drains the
+   events in a loop until the ioctl fails.
+
+*/
+
+#define _GNU_SOURCE
+#define _LARGEFILE64_SOURCE
+#include <dlfcn.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <linux/dvb/frontend.h>
+#include <linux/dvb/version.h>
+
+#if defined(RTLD_NEXT)
+#define REAL_LIBC RTLD_NEXT
+#else
+#define REAL_LIBC ((void *) -1L)
+#endif
+
+#define MAX_NODES 8
+#define DVB_FRAME 188
+#define CHUNK (348 * DVB_FRAME)
+
+#define NODE_FRONTEND 1
+#define NODE_DEMUXTS  2
+
+struct node {
+  int type;
+  int fd;        /* fd returned to the application */
+  int wfd;       /* demuxts: feeder side of the socketpair */
+  int input;
+  int running;
+  pthread_t thread;
+  struct timespec tuned;
+};
+
+/* Function pointers for real libc versions */
+static int (*real_open)(const char *pathname, int flags, ...);
+static int (*real_open64)(const char *pathname, int flags, ...);
+static int (*real_ioctl)(int fd, unsigned long request, ...);
+static int (*real_close)(int fd);
+
+static pthread_mutex_t nodes_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct node nodes[MAX_NODES];
+static int log_fd = -1;
+
+#define REDIR(realptr, symname) do { \
+  if ((realptr) == NULL) { \
+    (realptr) = dlsym(REAL_LIBC, symname); \
+    if ((realptr) == NULL) exit(1001); \
+  } \
+} while (0)
+
+/* log function */
+static void rlog(const char *fmt, ...)
+{
+  char buf[512];
+  va_list ap;
+  int keep_errno = errno;
+
+  if (log_fd < 0) {
+    const char *f = getenv("AXE_REPLAY_LOG");
+    REDIR(real_open, "open");
+    log_fd = f ? real_open(f, O_CREAT|O_APPEND|O_WRONLY, 0600) : 2 /* stderr */;
+    if (log_fd < 0)
+      log_fd = 2;
+  }
+  strcpy(buf, "axe-replay: ");
+  va_start(ap, fmt);
+  vsnprintf(buf + 12, sizeof(buf) - 12, fmt, ap);
+  va_end(ap);
+  if (write(log_fd, buf, strlen(buf)) < 0) {
+    /* nothing to do */
+  }
+  errno = keep_errno;
+}
+
+static int env_int(const char *name, int def)
+{
+  const char *s = getenv(name);
+  return s ? atoi(s) : def;
+}
+
+static int64_t elapsed_ms(struct timespec *from)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ts.tv_sec - from->tv_sec) * 1000LL +
+         (ts.tv_nsec - from->tv_nsec) / 1000000;
+}
+
+static struct node *find_node(int fd)
+{
+  int i;
+
+  if (fd < 0)
+    return NULL;
+  for (i = 0; i < MAX_NODES; i++)
+    if (nodes[i].type && nodes[i].fd == fd)
+      return &nodes[i];
+  return NULL;
+}
+
+static struct node *find_frontend(int input)
+{
+  int i;
+
+  for (i = 0; i < MAX_NODES; i++)
+    if (nodes[i].type == NODE_FRONTEND && nodes[i].input == input)
+      return &nodes[i];
+  return NULL;
+}
+
+/* 27MHz PCR of the packet or -1 */
+static int64_t ts_pcr(const unsigned char *b)
+{
+  if ((b[3] & 0x20) == 0 || b[4] < 7 || (b[5] & 0x10) == 0)
+    return -1;
+  return (((int64_t)b[6] << 25) | (b[7] << 17) | (b[8] << 9) |
+          (b[9] << 1) | (b[10] >> 7)) * 300 + (((b[10] & 1) << 8) | b[11]);
+}
+
+/*
+ * Feeder thread - writes the file to the demuxts socket, the first PID
+ * with PCR is used as the clock in the pcr mode.
+ */
+static void *feeder(void *arg)
+{
+  struct node *n = arg;
+  const char *file = getenv("AXE_REPLAY_FILE");
+  const char *rate = getenv("AXE_REPLAY_RATE");
+  int paced = !rate || strcmp(rate, "max");
+  static unsigned char buf[MAX_NODES][CHUNK];
+  unsigned char *b = buf[n - nodes];
+  struct timespec start;
+  int64_t pcr, pcr0 = -1, delta, ms;
+  int fd, pcr_pid = -1, pid, len, off, i;
+  ssize_t r;
+
+  if (!file) {
+    rlog("AXE_REPLAY_FILE is not set\n");
+    return NULL;
+  }
+  REDIR(real_open, "open");
+  fd = real_open(file, O_RDONLY);
+  if (fd < 0) {
+    rlog("unable to open '%s': %s\n", file, strerror(errno));
+    return NULL;
+  }
+  rlog("demuxts %d: serving '%s' (%s)\n", n->input, file, paced ? "pcr" : "max");
+  while (n->running) {
+    len = read(fd, b, CHUNK);
+    if (len <= 0) {
+      lseek(fd, 0, SEEK_SET);
+      pcr0 = -1;
+      continue;
+    }
+    len -= len % DVB_FRAME;
+    if (paced) {
+      /* sleep until the wallclock reaches the last PCR in the chunk */
+      for (i = len - DVB_FRAME, pcr = -1; i >= 0 && pcr < 0; i -= DVB_FRAME) {
+        if (b[i] != 0x47)
+          continue;
+        pid = ((b[i + 1] & 0x1f) << 8) | b[i + 2];
+        if (pcr_pid >= 0 && pid != pcr_pid)
+          continue;
+        if ((pcr = ts_pcr(b + i)) >= 0)
+          pcr_pid = pid;
+      }
+      if (pcr >= 0) {
+        if (pcr0 < 0 || pcr < pcr0) {
+          pcr0 = pcr;
+          clock_gettime(CLOCK_MONOTONIC, &start);
+        }
+        delta = (pcr - pcr0) / 27000;
+        ms = elapsed_ms(&start);
+        if (delta > ms + 2000) {
+          /* discontinuity */
+          pcr0 = pcr;
+          clock_gettime(CLOCK_MONOTONIC, &start);
+        } else if (delta > ms) {
+          usleep((delta - ms) * 1000);
+        }
+      }
+    }
+    for (off = 0; off < len && n->running; off += r) {
+      r = send(n->wfd, b + off, len - off, MSG_NOSIGNAL);
+      if (r < 0) {
+        if (errno == EINTR)
+          r = 0;
+        else
+          goto end;
+      }
+    }
+  }
+end:
+  real_close(fd);
+  rlog("demuxts %d: feeder stopped\n", n->input);
+  return NULL;
+}
+
+static int node_open(const char *pathname)
+{
+  struct node *n = NULL;
+  int i, type, input, sv[2], size = 4 * 1024 * 1024;
+
+  if (sscanf(pathname, "/dev/axe/frontend-%d", &input) == 1)
+    type = NODE_FRONTEND;
+  else if (sscanf(pathname, "/dev/axe/demuxts-%d", &input) == 1)
+    type = NODE_DEMUXTS;
+  else
+    return -2;
+  if (input < 0 || input >= env_int("AXE_REPLAY_ADAPTERS", 4)) {
+    errno = ENOENT;
+    return -1;
+  }
+  pthread_mutex_lock(&nodes_lock);
+  for (i = 0; i < MAX_NODES; i++)
+    if (nodes[i].type == 0) {
+      n = &nodes[i];
+      break;
+    }
+  if (n == NULL) {
+    pthread_mutex_unlock(&nodes_lock);
+    errno = EMFILE;
+    return -1;
+  }
+  memset(n, 0, sizeof(*n));
+  n->input = input;
+  n->wfd = -1;
+  if (type == NODE_FRONTEND) {
+    n->fd = real_open("/dev/null", O_RDWR);
+  } else {
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+      pthread_mutex_unlock(&nodes_lock);
+      return -1;
+    }
+    setsockopt(sv[0], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(sv[1], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK);
+    n->fd = sv[0];
+    n->wfd = sv[1];
+    n->running = 1;
+  }
+  if (n->fd >= 0) {
+    n->type = type;
+    if (type == NODE_DEMUXTS &&
+        pthread_create(&n->thread, NULL, feeder, n)) {
+      real_close(n->fd);
+      real_close(n->wfd);
+      n->type = 0;
+      n->fd = -1;
+    }
+  }
+  pthread_mutex_unlock(&nodes_lock);
+  rlog("open('%s') = %d\n", pathname, n->fd);
+  return n->fd;
+}
+
+/* open() wrapper */
+int open(const char *pathname, int flags, ...)
+{
+  va_list ap;
+  mode_t mode = 0;
+  int r;
+
+  REDIR(real_open, "open");
+  REDIR(real_close, "close");
+
+  if ((r = node_open(pathname)) != -2)
+    return r;
+  if (flags & O_CREAT) {
+    va_start(ap, flags);
+    mode = va_arg(ap, mode_t);
+    va_end(ap);
+  }
+  return real_open(pathname, flags, mode);
+}
+
+/* open64() wrapper */
+int open64(const char *pathname, int flags, ...)
+{
+  va_list ap;
+  mode_t mode = 0;
+  int r;
+
+  REDIR(real_open, "open");
+  REDIR(real_open64, "open64");
+  REDIR(real_close, "close");
+
+  if ((r = node_open(pathname)) != -2)
+    return r;
+  if (flags & O_CREAT) {
+    va_start(ap, flags);
+    mode = va_arg(ap, mode_t);
+    va_end(ap);
+  }
+  return real_open64(pathname, flags, mode);
+}
+
+/* close() wrapper */
+int close(int fd)
+{
+  struct node *n;
+
+  REDIR(real_close, "close");
+
+  pthread_mutex_lock(&nodes_lock);
+  n = find_node(fd);
+  if (n && n->type == NODE_DEMUXTS) {
+    n->running = 0;
+    shutdown(n->wfd, SHUT_RDWR);
+    pthread_mutex_unlock(&nodes_lock);
+    pthread_join(n->thread, NULL);
+    pthread_mutex_lock(&nodes_lock);
+    real_close(n->wfd);
+  }
+  if (n)
+    n->type = 0;
+  pthread_mutex_unlock(&nodes_lock);
+  return real_close(fd);
+}
+
+static void fe_get_property(struct node *n, struct dtv_properties *props, int locked)
+{
+  struct dtv_property *p;
+  unsigned i;
+
+  for (i = 0; i < props->num; i++) {
+    p = &props->props[i];
+    switch (p->cmd) {
+    case DTV_API_VERSION:
+      p->u.data = (DVB_API_VERSION << 8) | DVB_API_VERSION_MINOR;
+      break;
+    case DTV_ENUM_DELSYS:
+      p->u.buffer.data[0] = SYS_DVBS;
+      p->u.buffer.data[1] = SYS_DVBS2;
+      p->u.buffer.len = 2;
+      break;
+#ifdef DTV_STAT_SIGNAL_STRENGTH
+    case DTV_STAT_SIGNAL_STRENGTH:
+    case DTV_STAT_CNR:
+      p->u.st.len = 1;
+      p->u.st.stat[0].scale = FE_SCALE_RELATIVE;
+      p->u.st.stat[0].uvalue = locked ? 0xffff * env_int("AXE_REPLAY_SNR", 80) / 100 : 0;
+      break;
+#endif
+    default:
+      memset(&p->u, 0, sizeof(p->u));
+      break;
+    }
+  }
+}
+
+static int fe_ioctl(struct node *n, unsigned long request, void *arg)
+{
+  struct dvb_frontend_info *info;
+  struct dtv_properties *props;
+  int locked, snr = env_int("AXE_REPLAY_SNR", 80);
+  unsigned i;
+
+  locked = n->tuned.tv_sec && elapsed_ms(&n->tuned) >= env_int("AXE_REPLAY_LOCK_MS", 300);
+  switch (request) {
+  case FE_GET_INFO:
+    info = arg;
+    memset(info, 0, sizeof(*info));
+    snprintf(info->name, sizeof(info->name), "STV0900 replay %d", n->input);
+    info->type = FE_QPSK;
+    info->frequency_min = 950000;
+    info->frequency_max = 2150000;
+    info->symbol_rate_min = 1000000;
+    info->symbol_rate_max = 45000000;
+    info->caps = FE_CAN_INVERSION_AUTO | FE_CAN_FEC_AUTO | FE_CAN_QPSK |
+                 FE_CAN_2G_MODULATION | FE_CAN_MULTISTREAM;
+    return 0;
+  case FE_READ_STATUS:
+    *(fe_status_t *)arg = locked ? FE_HAS_SIGNAL | FE_HAS_CARRIER |
+      FE_HAS_VITERBI | FE_HAS_SYNC | FE_HAS_LOCK : 0;
+    return 0;
+  case FE_READ_SIGNAL_STRENGTH:
+    *(uint16_t *)arg = locked ? 0xffff * (snr + (100 - snr) / 2) / 100 : 0;
+    return 0;
+  case FE_READ_SNR:
+    *(uint16_t *)arg = locked ? 0xffff * snr / 100 : 0;
+    return 0;
+  case FE_READ_BER:
+  case FE_READ_UNCORRECTED_BLOCKS:
+    *(uint32_t *)arg = 0;
+    return 0;
+  case FE_SET_PROPERTY:
+    props = arg;
+    for (i = 0; i < props->num; i++)
+      if (props->props[i].cmd == DTV_TUNE) {
+        clock_gettime(CLOCK_MONOTONIC, &n->tuned);
+        rlog("frontend %d: tune\n", n->input);
+      }
+    return 0;
+  case FE_GET_PROPERTY:
+    fe_get_property(n, arg, locked);
+    return 0;
+  case FE_GET_EVENT:
+    errno = EWOULDBLOCK;
+    return -1;
+  }
+  return -2;
+}
+
+/* ioctl() wrapper */
+int ioctl(int fd, unsigned long request, ...)
+{
+  va_list ap;
+  unsigned long arg;
+  struct node *n;
+  int r;
+
+  REDIR(real_ioctl, "ioctl");
+
+  /* Get argument */
+  va_start(ap, request);
+  arg = va_arg(ap, unsigned long);
+  va_end(ap);
+
+  pthread_mutex_lock(&nodes_lock);
+  n = find_node(fd);
+  if (n == NULL) {
+    pthread_mutex_unlock(&nodes_lock);
+    return real_ioctl(fd, request, arg);
+  }
+  r = n->type == NODE_FRONTEND ? fe_ioctl(n, request, (void *)arg) : -2;
+  if (r == -2) {
+    /* AXE specific (input selection, dmxts pid filters) or unknown */
+    if ((_IOC_DIR(request) & _IOC_READ) && arg)
+      memset((void *)arg, 0, _IOC_SIZE(request));
+    /* the demuxts start is also a tune for the frontend on the same input */
+    if (n->type == NODE_DEMUXTS && (n = find_frontend(n->input)) != NULL &&
+        n->tuned.tv_sec == 0)
+      clock_gettime(CLOCK_MONOTONIC, &n->tuned);
+    r = 0;
+  }
+  pthread_mutex_unlock(&nodes_lock);
+  return r;
+}
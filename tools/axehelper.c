@@ -17,6 +17,10 @@
 #define I2C_M_NOREPSTART 0
 #endif
 
+#ifndef I2C_RDRW_IOCTL_MAX_MSGS
+#define I2C_RDRW_IOCTL_MAX_MSGS 42
+#endif
+
 typedef unsigned char u8;
 
 static unsigned long
@@ -777,14 +781,35 @@ i2c_demod_prefix(int reg)
 	return "";
 }
 
-static struct reg *i2c_demod_find(int reg)
+/*
+ * direct-indexed 0xf100..0xffff register table, the P1 registers point
+ * to the P2 entries (the decoder table lists only P2)
+ */
+static struct reg *demod_reg_idx[0x10000 - 0xf100];
+
+static void
+i2c_demod_index(void)
 {
-	int reg2 = reg >= 0xf400 && reg < 0xf600 ? reg - 0x200 : reg;
+	static int done;
 	struct reg *rt;
+	int reg;
+
+	if (done)
+		return;
 	for (rt = demod_reg_tbl; rt->name; rt++)
-		if (rt->reg == reg2)
-			break;
-	return rt->name ? rt : NULL;
+		if (i2c_demod_valid(rt->reg) && demod_reg_idx[rt->reg - 0xf100] == NULL)
+			demod_reg_idx[rt->reg - 0xf100] = rt;
+	for (reg = 0xf400; reg < 0xf600; reg++)
+		demod_reg_idx[reg - 0xf100] = demod_reg_idx[reg - 0x200 - 0xf100];
+	done = 1;
+}
+
+static struct reg *i2c_demod_find(int reg)
+{
+	if (!i2c_demod_valid(reg))
+		return NULL;
+	i2c_demod_index();
+	return demod_reg_idx[reg - 0xf100];
 }
 
 static const char *i2c_print_old(const char *s)
@@ -794,6 +819,65 @@ static const char *i2c_print_old(const char *s)
 	return "";
 }
 
+static const char *
+hex_parse(const char *s, int *val)
+{
+	int v = 0, c, n = 0;
+
+	while (*s == ' ')
+		s++;
+	for (;; s++, n++) {
+		c = *s;
+		if (c >= '0' && c <= '9')
+			c -= '0';
+		else if (c >= 'a' && c <= 'f')
+			c -= 'a' - 10;
+		else if (c >= 'A' && c <= 'F')
+			c -= 'A' - 10;
+		else
+			break;
+		v = (v << 4) | c;
+	}
+	if (n == 0)
+		return NULL;
+	*val = v;
+	return s;
+}
+
+/*
+ * "addr, cnt) d0.d1..." (up to 16 data bytes), returns the number
+ * of the parsed items like the sscanf() it replaces
+ */
+static int
+i2c_parse(const char *s, int *addr, int *cnt, int *d)
+{
+	int r = 0, v;
+
+	if ((s = hex_parse(s, addr)) == NULL)
+		return r;
+	r++;
+	if (*s++ != ',')
+		return r;
+	while (*s == ' ')
+		s++;
+	if (*s < '0' || *s > '9')
+		return r;
+	for (v = 0; *s >= '0' && *s <= '9'; s++)
+		v = v * 10 + *s - '0';
+	*cnt = v;
+	r++;
+	if (*s++ != ')')
+		return r;
+	while (r < 18) {
+		if ((s = hex_parse(s, &d[r - 2])) == NULL)
+			break;
+		r++;
+		if (*s++ != '.')
+			break;
+	}
+	return r;
+}
+
 static int
 i2c_line(int rd, int t1, int start, const char *s)
 {
@@ -804,10 +888,7 @@ i2c_line(int rd, int t1, int start, const char *s)
 	struct regdmp *rtd;
 	char buf[1024];
 
-	r = sscanf(s + start, "%x, %d) %x.%x.%x.%x.%x.%x.%x.%x.%x.%x.%x.%x.%x.%x.%x.%x",
-	           &addr, &cnt,
-	           &d[0], &d[1], &d[2], &d[3], &d[4], &d[5], &d[6], &d[7],
-	           &d[8], &d[9], &d[10], &d[11], &d[12], &d[13], &d[14], &d[15]);
+	r = i2c_parse(s + start, &addr, &cnt, d);
         if (r < 3 || cnt != r - 2)
         	return -1;
 	if (addr < 0xd0 && addr > 0xd3)
@@ -894,14 +975,71 @@ wr:
 	return 0;
 }
 
+/* must match struct i2c_trace_rec in kernel/drivers/i2c/i2c-core.c */
+struct i2c_trace_rec {
+	unsigned long long ts;
+	unsigned int seq;
+	unsigned int dur;
+	unsigned short addr;
+	unsigned short flags;
+	unsigned short len;
+	short result;
+	u8 adap;
+	u8 msg;
+	u8 nmsgs;
+	u8 cpu;
+	u8 data[12];
+};
+
+/*
+ * binary records from <debugfs>/i2c/trace, the messages are converted
+ * to the ivo_i2c text format and passed to the same decoder
+ */
+static void
+i2c_decoder_bin(FILE *in)
+{
+	struct i2c_trace_rec rec;
+	unsigned int seq = 0;
+	char buf[256];
+	int i, cnt, start, rd;
+
+	while (fread(&rec, sizeof(rec), 1, in) == 1) {
+		if (seq && rec.seq != seq + 1)
+			printf("# %u records lost\n", rec.seq - seq - 1);
+		seq = rec.seq;
+		rd = (rec.flags & I2C_M_RD) != 0;
+		cnt = rec.len < sizeof(rec.data) ? rec.len : sizeof(rec.data);
+		if (rd && rec.result < 0)
+			cnt = 0;
+		snprintf(buf, sizeof(buf), "%5llu.%06llu %5uus i2c-%u %d/%d%s [i2c] %s(",
+			 rec.ts / 1000000000ULL, (rec.ts / 1000) % 1000000ULL,
+			 rec.dur / 1000, rec.adap, rec.msg + 1, rec.nmsgs,
+			 rec.result < 0 ? " ERR" : "", rd ? "read" : "wrte");
+		start = strlen(buf);
+		snprintf(buf + start, sizeof(buf) - start, "%02x, %d)",
+			 (rec.addr << 1) | rd, cnt);
+		for (i = 0; i < cnt; i++)
+			snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf),
+				 "%s%02x", i > 0 ? "." : " ", rec.data[i]);
+		if (rec.len > cnt && !(rd && rec.result < 0))
+			snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), " (+%d)", rec.len - cnt);
+		if (i2c_line(rd, 0, start, buf) < 0)
+			printf("%s\n", buf);
+	}
+}
+
 static void 
-i2c_decoder(void)
+i2c_decoder(FILE *in, int bin)
 {
 	char buf[1024];
 	int r;
 
-	while (!feof(stdin)) {
-		if (fgets(buf, sizeof(buf), stdin) == NULL)
+	if (bin) {
+		i2c_decoder_bin(in);
+		return;
+	}
+	while (!feof(in)) {
+		if (fgets(buf, sizeof(buf), in) == NULL)
 			break;
 		if (buf[0] == '\0')
 			continue;
@@ -920,7 +1058,66 @@ i2c_decoder(void)
 	}
 }
 
+/* decode a captured trace file several times, the output is discarded */
+static int
+i2c_decoder_bench(const char *name, int passes, int bin)
+{
+	unsigned long t;
+	long size;
+	FILE *f;
+	int i;
+
+	if (passes < 1)
+		passes = 1;
+	if ((f = fopen(name, "r")) == NULL) {
+		printf("Unable to open '%s'\n", name);
+		return -1;
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fflush(stdout);
+	if (freopen("/dev/null", "w", stdout) == NULL) {
+		fclose(f);
+		return -1;
+	}
+	t = getTick();
+	for (i = 0; i < passes; i++) {
+		rewind(f);
+		i2c_decoder(f, bin);
+	}
+	fflush(stdout);
+	t = getTick() - t;
+	fclose(f);
+	fprintf(stderr, "%s: %ld bytes, %d passes, %lu ms, %lu ms/pass, %lu kB/s\n",
+		name, size, passes, t, t / passes, t ? size / 1024 * passes * 1000 / t : 0);
+	return 0;
+}
+
 static int i2c_fd = -1;
+static int i2c_rpt_auto;
+
+/*
+ * The i2c_mangle module keeps the STV6120 repeater open between the tuner
+ * accesses and opens it itself when required, the repeater messages
+ * are not sent then.
+ */
+static int
+i2c_repeater_auto(int num)
+{
+	char buf[64];
+	int fd, r;
+
+	sprintf(buf, "/sys/bus/i2c/devices/i2c-%d/i2c_mangle_repeater", num);
+	fd = open(buf, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	r = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (r <= 0)
+		return 0;
+	buf[r] = '\0';
+	return atoi(buf) > 0;
+}
 
 static int
 i2c_open(int num, char *_path)
@@ -933,6 +1130,7 @@ i2c_open(int num, char *_path)
 	i2c_fd = open(path, O_RDWR);
 	if (i2c_fd < 0)
 		return -1;
+	i2c_rpt_auto = num < 8 && i2c_repeater_auto(num);
 	if (_path)
 		strcpy(_path, path);
 	return 0;
@@ -971,11 +1169,13 @@ i2c_reg_read(int addr, int reg, u8 *buf, int cnt, int trans)
 	/* STV0610 */
 	if (addr == 0xc0 || addr == 0xc6) {
 		fmask = I2C_M_NOREPSTART;
-		m[mi].addr = (addr == 0xc0 ? 0xd0 : 0xd2) >> 1;
-		m[mi].len = sizeof(i2c_repeater);
-		m[mi].flags = fmask;
-		m[mi].buf = i2c_repeater;
-		mi++;
+		if (!i2c_rpt_auto) {
+			m[mi].addr = (addr == 0xc0 ? 0xd0 : 0xd2) >> 1;
+			m[mi].len = sizeof(i2c_repeater);
+			m[mi].flags = fmask;
+			m[mi].buf = i2c_repeater;
+			mi++;
+		}
 	}
 
 	if (reg < 256) {
@@ -992,7 +1192,7 @@ i2c_reg_read(int addr, int reg, u8 *buf, int cnt, int trans)
 	mi++;
 
 	/* STV0610 */
-	if (addr == 0xc0 || addr == 0xc6) {
+	if ((addr == 0xc0 || addr == 0xc6) && !i2c_rpt_auto) {
 		m[mi].addr = (addr == 0xc0 ? 0xd0 : 0xd2) >> 1;
 		m[mi].len = sizeof(i2c_repeater);
 		m[mi].flags = fmask;
@@ -1033,11 +1233,13 @@ i2c_reg_write(int addr, int reg, u8 *buf, int cnt, int trans)
 	/* STV0610 */
 	if (addr == 0xc0 || addr == 0xc6) {
 		fmask = I2C_M_NOREPSTART;
-		m[mi].addr = (addr == 0xc0 ? 0xd0 : 0xd2) >> 1;
-		m[mi].len = sizeof(i2c_repeater);
-		m[mi].flags = fmask;
-		m[mi].buf = i2c_repeater;
-		mi++;
+		if (!i2c_rpt_auto) {
+			m[mi].addr = (addr == 0xc0 ? 0xd0 : 0xd2) >> 1;
+			m[mi].len = sizeof(i2c_repeater);
+			m[mi].flags = fmask;
+			m[mi].buf = i2c_repeater;
+			mi++;
+		}
 	}
 
 	if (reg < 256) {
@@ -1064,6 +1266,419 @@ i2c_reg_write(int addr, int reg, u8 *buf, int cnt, int trans)
 	return cnt;
 }
 
+/*
+ * Register map dump - the ranges are read with as few I2C_RDWR calls
+ * as possible (up to I2C_RDRW_IOCTL_MAX_MSGS messages each)
+ */
+
+#define I2C_DUMP_MAX	512
+#define I2C_DUMP_GAP	4	/* unknown registers read to join two ranges */
+#define I2C_DUMP_CHUNK	64	/* bytes per read message */
+
+struct i2c_range {
+	int addr;
+	int lo, hi;
+};
+
+static struct i2c_range i2c_dump_tbl[I2C_DUMP_MAX];
+static int i2c_dump_num;
+
+/* DISRXDATA read pops the DiSEqC receive FIFO */
+static int
+i2c_dump_noread(int addr, int reg)
+{
+	return (addr == 0xd0 || addr == 0xd2) && (reg == 0xf196 || reg == 0xf1a6);
+}
+
+static void
+i2c_dump_add(int addr, int lo, int hi)
+{
+	struct i2c_range *r = i2c_dump_num > 0 ? &i2c_dump_tbl[i2c_dump_num - 1] : NULL;
+	int reg;
+
+	if (r && r->addr == addr && lo >= r->lo && lo <= r->hi + I2C_DUMP_GAP + 1) {
+		for (reg = r->hi + 1; reg < lo; reg++)
+			if (i2c_dump_noread(addr, reg))
+				break;
+		if (reg >= lo) {
+			if (hi > r->hi)
+				r->hi = hi;
+			return;
+		}
+	}
+	if (i2c_dump_num >= I2C_DUMP_MAX)
+		return;
+	r = &i2c_dump_tbl[i2c_dump_num++];
+	r->addr = addr;
+	r->lo = lo;
+	r->hi = hi;
+}
+
+static int
+i2c_dump_cmp(const void *a, const void *b)
+{
+	return *(const int *)a - *(const int *)b;
+}
+
+/* all registers known to the decoder (P2 ones mirrored to P1) and the tuners */
+static void
+i2c_dump_builtin(void)
+{
+	static const int demods[] = { 0xd0, 0xd2 };
+	static const int tuners[] = { 0xc0, 0xc6 };
+	static int regs[2 * sizeof(demod_reg_tbl) / sizeof(demod_reg_tbl[0])];
+	struct reg *rt;
+	int i, j, n = 0;
+
+	for (rt = demod_reg_tbl; rt->name; rt++) {
+		regs[n++] = rt->reg;
+		if (rt->reg >= 0xf200 && rt->reg < 0xf400)
+			regs[n++] = rt->reg + 0x200;
+	}
+	qsort(regs, n, sizeof(regs[0]), i2c_dump_cmp);
+	for (i = 0; i < 2; i++) {
+		for (j = 0; j < n; j++)
+			if (!i2c_dump_noread(demods[i], regs[j]))
+				i2c_dump_add(demods[i], regs[j], regs[j]);
+		i2c_dump_add(tuners[i], 0x00, 0x18);
+	}
+}
+
+/* lines with "addr reg [count]" like i2c_reg_read, # starts a comment */
+static int
+i2c_dump_file(const char *name)
+{
+	FILE *f = name ? fopen(name, "r") : stdin;
+	char buf[256], *p;
+	int a, r, c, n;
+
+	if (f == NULL) {
+		printf("Unable to open %s\n", name);
+		return -1;
+	}
+	while (fgets(buf, sizeof(buf), f)) {
+		if ((p = strchr(buf, '#')) != NULL)
+			*p = '\0';
+		c = 1;
+		n = sscanf(buf, "%i %i %i", &a, &r, &c);
+		if (n < 2)
+			continue;
+		if (a < 0 || r < 0 || c < 1)
+			continue;
+		i2c_dump_add(a, r, r + c - 1);
+	}
+	if (f != stdin)
+		fclose(f);
+	return 0;
+}
+
+static void
+i2c_dump_print(int addr, int reg, u8 *data, int cnt, int decode)
+{
+	char buf[256];
+	int i, j, n;
+
+	for (i = 0; i < cnt; i += n, reg += n) {
+		n = cnt - i > 16 ? 16 : cnt - i;
+		if (decode && reg >= 256) {
+			sprintf(buf, "  > (%x, %d) %02x.%02x", addr & ~1, 2, (reg >> 8) & 0xff, reg & 0xff);
+			if (i2c_line(0, 0, 5, buf) >= 0) {
+				sprintf(buf, "  < (%x, %d) ", addr | 1, n);
+				for (j = 0; j < n; j++)
+					sprintf(buf + strlen(buf), "%s%02x", j > 0 ? "." : "", data[i + j]);
+				if (i2c_line(1, 0, 5, buf) >= 0)
+					continue;
+			}
+		}
+		printf("0x%02x 0x%04x:", addr, reg);
+		for (j = 0; j < n; j++)
+			printf(" %02x", data[i + j]);
+		printf("\n");
+	}
+}
+
+static int
+i2c_dump_size(void)
+{
+	int i, size = 0;
+
+	for (i = 0; i < i2c_dump_num; i++)
+		size += i2c_dump_tbl[i].hi - i2c_dump_tbl[i].lo + 1;
+	return size;
+}
+
+/* read all ranges to out, the register values follow each other in the table order */
+static int
+i2c_dump_read(u8 *out)
+{
+	u8 regbuf[I2C_RDRW_IOCTL_MAX_MSGS / 2][2];
+	struct i2c_msg m[I2C_RDRW_IOCTL_MAX_MSGS];
+	struct i2c_rdwr_ioctl_data d;
+	int i, j, mi, np, reg, addr, cnt, tuner, fmask, pos = 0;
+
+	if (i2c_open_check())
+		return -1;
+	i = 0;
+	reg = i2c_dump_num > 0 ? i2c_dump_tbl[0].lo : 0;
+	while (i < i2c_dump_num) {
+		/* fill one I2C_RDWR call */
+		mi = np = 0;
+		while (i < i2c_dump_num) {
+			addr = i2c_dump_tbl[i].addr;
+			tuner = addr == 0xc0 || addr == 0xc6;
+			if (mi + (tuner && !i2c_rpt_auto ? 4 : 2) > I2C_RDRW_IOCTL_MAX_MSGS)
+				break;
+			cnt = i2c_dump_tbl[i].hi - reg + 1;
+			if (cnt > I2C_DUMP_CHUNK)
+				cnt = I2C_DUMP_CHUNK;
+			fmask = tuner ? I2C_M_NOREPSTART : 0;
+			if (tuner && !i2c_rpt_auto) {
+				m[mi].addr = (addr == 0xc0 ? 0xd0 : 0xd2) >> 1;
+				m[mi].len = sizeof(i2c_repeater);
+				m[mi].flags = fmask;
+				m[mi++].buf = i2c_repeater;
+			}
+			j = 0;
+			if (reg >= 256)
+				regbuf[np][j++] = reg >> 8;
+			regbuf[np][j++] = reg;
+			m[mi].addr = addr >> 1;
+			m[mi].len = j;
+			m[mi].flags = fmask;
+			m[mi++].buf = regbuf[np++];
+			if (tuner && !i2c_rpt_auto) {
+				m[mi].addr = (addr == 0xc0 ? 0xd0 : 0xd2) >> 1;
+				m[mi].len = sizeof(i2c_repeater);
+				m[mi].flags = fmask;
+				m[mi++].buf = i2c_repeater;
+			}
+			m[mi].addr = addr >> 1;
+			m[mi].len = cnt;
+			m[mi].flags = fmask | I2C_M_RD;
+			m[mi++].buf = out + pos;
+			pos += cnt;
+			reg += cnt;
+			if (reg > i2c_dump_tbl[i].hi && ++i < i2c_dump_num)
+				reg = i2c_dump_tbl[i].lo;
+		}
+		d.nmsgs = mi;
+		d.msgs = m;
+		if (ioctl(i2c_fd, I2C_RDWR, &d) < 0) {
+			printf("I2C RDWR failed for addr 0x%x\n", m[0].addr << 1);
+			return -1;
+		}
+	}
+	return pos;
+}
+
+static int
+i2c_dump(int decode)
+{
+	unsigned long t = getTick();
+	int i, total, pos = 0;
+	u8 *data;
+
+	data = malloc(i2c_dump_size() + 1);
+	if (data == NULL)
+		return -1;
+	total = i2c_dump_read(data);
+	if (total < 0) {
+		free(data);
+		return -1;
+	}
+	for (i = 0; i < i2c_dump_num; i++) {
+		if (i == 0 || i2c_dump_tbl[i].addr != i2c_dump_tbl[i - 1].addr)
+			printf(">>> 0x%02x\n", i2c_dump_tbl[i].addr);
+		i2c_dump_print(i2c_dump_tbl[i].addr, i2c_dump_tbl[i].lo, data + pos,
+			       i2c_dump_tbl[i].hi - i2c_dump_tbl[i].lo + 1, decode);
+		pos += i2c_dump_tbl[i].hi - i2c_dump_tbl[i].lo + 1;
+	}
+	printf("# %d registers in %lu ms\n", total, getTick() - t);
+	free(data);
+	return 0;
+}
+
+/*
+ * Register monitor - the ranges are sampled every <ms> milliseconds and
+ * stored either as binary records (header with the ranges, then u32 ms
+ * and the raw register values per sample) or as CSV with the fields
+ * decoded by the regdmp tables. The file is moved to <file>.1 when it
+ * grows over MON_MAXSIZE, so a tmpfs cannot be filled up.
+ */
+
+#define MON_MAGIC	"AXEMON1\n"
+#define MON_MAXSIZE	(1024 * 1024)
+
+/* lock state, MODCOD, AGC, carrier offset, packet delineator, TS and error counters */
+static void
+mon_builtin(void)
+{
+	static const int demods[] = { 0xd0, 0xd2 };
+	static const int regs[][2] = {
+		{ 0xf20e, 0xf213 },	/* AGCIQIN1/0, DMDMODCOD, DSTATUS, DSTATUS2 */
+		{ 0xf24c, 0xf24e },	/* CFR2..0 */
+		{ 0xf369, 0xf36a },	/* PDELSTATUS1/2 */
+		{ 0xf381, 0xf382 },	/* TSSTATUS, TSSTATUS2 */
+		{ 0xf399, 0xf39f },	/* ERRCNT12..10, ERRCNT22..20 */
+	};
+	int i, p, r;
+
+	for (i = 0; i < 2; i++)
+		for (p = 0; p <= 0x200; p += 0x200)	/* P2, P1 */
+			for (r = 0; r < sizeof(regs) / sizeof(regs[0]); r++)
+				i2c_dump_add(demods[i], regs[r][0] + p, regs[r][1] + p);
+}
+
+static struct reg *
+mon_find(int addr, int reg)
+{
+	if (addr < 0xd0 || addr > 0xd3 || !i2c_demod_valid(reg))
+		return NULL;
+	return i2c_demod_find(reg);
+}
+
+static void
+mon_csv_header(FILE *f)
+{
+	struct regdmp *rtd;
+	struct reg *rt;
+	int i, reg, addr;
+
+	fprintf(f, "ms");
+	for (i = 0; i < i2c_dump_num; i++) {
+		addr = i2c_dump_tbl[i].addr;
+		for (reg = i2c_dump_tbl[i].lo; reg <= i2c_dump_tbl[i].hi; reg++) {
+			rt = mon_find(addr, reg);
+			if (rt == NULL) {
+				fprintf(f, ",%02x.%04x", addr, reg);
+				continue;
+			}
+			for (rtd = rt->dmp; rtd && rtd->name; rtd++)
+				fprintf(f, ",%02x.%s%s.%s", addr, i2c_demod_prefix(reg), rt->name, rtd->name);
+		}
+	}
+	fprintf(f, "\n");
+}
+
+static void
+mon_csv_line(FILE *f, unsigned int ms, u8 *data)
+{
+	struct regdmp *rtd;
+	struct reg *rt;
+	int i, reg;
+
+	fprintf(f, "%u", ms);
+	for (i = 0; i < i2c_dump_num; i++) {
+		for (reg = i2c_dump_tbl[i].lo; reg <= i2c_dump_tbl[i].hi; reg++, data++) {
+			rt = mon_find(i2c_dump_tbl[i].addr, reg);
+			if (rt == NULL) {
+				fprintf(f, ",%u", *data);
+				continue;
+			}
+			for (rtd = rt->dmp; rtd && rtd->name; rtd++)
+				fprintf(f, ",%u", (*data >> rtd->shift) & rtd->mask);
+		}
+	}
+	fprintf(f, "\n");
+}
+
+static FILE *
+mon_open(const char *name, int csv)
+{
+	FILE *f = fopen(name, "w");
+
+	if (f == NULL) {
+		printf("Unable to create %s\n", name);
+		return NULL;
+	}
+	if (csv) {
+		mon_csv_header(f);
+	} else {
+		fwrite(MON_MAGIC, 8, 1, f);
+		fwrite(&i2c_dump_num, sizeof(i2c_dump_num), 1, f);
+		fwrite(i2c_dump_tbl, sizeof(i2c_dump_tbl[0]), i2c_dump_num, f);
+	}
+	return f;
+}
+
+static int
+monitor(int ms, const char *name, long count, int csv)
+{
+	struct timespec next, now;
+	unsigned long t0;
+	unsigned int t;
+	char name1[256];
+	int size = i2c_dump_size();
+	FILE *f = NULL;
+	u8 *data;
+	long n;
+
+	if (ms <= 0 || i2c_dump_num == 0)
+		return -1;
+	data = malloc(size + 1);
+	if (data == NULL)
+		return -1;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	t0 = next.tv_sec * 1000 + next.tv_nsec / 1000000;
+	for (n = 0; count <= 0 || n < count; n++) {
+		if (f && ftell(f) > MON_MAXSIZE) {
+			fclose(f);
+			snprintf(name1, sizeof(name1), "%s.1", name);
+			rename(name, name1);
+			f = NULL;
+		}
+		if (f == NULL && (f = mon_open(name, csv)) == NULL)
+			break;
+		if (i2c_dump_read(data) < 0)
+			break;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		t = now.tv_sec * 1000 + now.tv_nsec / 1000000 - t0;
+		if (csv) {
+			mon_csv_line(f, t, data);
+		} else {
+			fwrite(&t, sizeof(t), 1, f);
+			fwrite(data, size, 1, f);
+		}
+		fflush(f);
+		/* absolute deadlines, the rate does not drift with the I2C time */
+		next.tv_nsec += (ms % 1000) * 1000000;
+		next.tv_sec += ms / 1000 + next.tv_nsec / 1000000000;
+		next.tv_nsec %= 1000000000;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) > 0);
+	}
+	if (f)
+		fclose(f);
+	free(data);
+	return count > 0 && n < count ? -1 : 0;
+}
+
+/* binary monitor file (stdin) to CSV (stdout) */
+static int
+monitor_csv(void)
+{
+	char magic[8];
+	unsigned int t;
+	int size;
+	u8 *data;
+
+	if (fread(magic, 8, 1, stdin) != 1 || memcmp(magic, MON_MAGIC, 8) ||
+	    fread(&i2c_dump_num, sizeof(i2c_dump_num), 1, stdin) != 1 ||
+	    i2c_dump_num < 0 || i2c_dump_num > I2C_DUMP_MAX ||
+	    fread(i2c_dump_tbl, sizeof(i2c_dump_tbl[0]), i2c_dump_num, stdin) != i2c_dump_num) {
+		printf("Not a monitor file\n");
+		return -1;
+	}
+	size = i2c_dump_size();
+	data = malloc(size + 1);
+	if (data == NULL)
+		return -1;
+	mon_csv_header(stdout);
+	while (fread(&t, sizeof(t), 1, stdin) == 1 && fread(data, size, 1, stdin) == 1)
+		mon_csv_line(stdout, t, data);
+	free(data);
+	return 0;
+}
+
 static void
 i2c_scan(void)
 {
@@ -1143,7 +1758,14 @@ main(int _argc, char *_argv[])
 				break;
 	}
 	if (argc > 1 && !strcmp(argv[1], "i2c_decoder")) {
-		i2c_decoder();
+		if (find_opt("bench")) {
+			if (argc <= 2)
+				exit(EXIT_FAILURE);
+			if (i2c_decoder_bench(argv[2], argc > 3 ? atoi(argv[3]) : 10, find_opt("bin")))
+				exit(EXIT_FAILURE);
+		} else {
+			i2c_decoder(stdin, find_opt("bin"));
+		}
 	}
 	if (argc > 1 && !strcmp(argv[1], "i2c_scan")) {
 		i2c_scan();
@@ -1184,6 +1806,35 @@ main(int _argc, char *_argv[])
 		}
 		exit(EXIT_SUCCESS);
 	}
+	if (argc > 1 && !strcmp(argv[1], "i2c_dump")) {
+		if (argc > 2 || find_opt("stdin")) {
+			if (i2c_dump_file(argc > 2 ? argv[2] : NULL))
+				exit(EXIT_FAILURE);
+		} else {
+			i2c_dump_builtin();
+		}
+		if (i2c_dump(!find_opt("raw")))
+			exit(EXIT_FAILURE);
+		exit(EXIT_SUCCESS);
+	}
+	if (argc > 1 && !strcmp(argv[1], "monitor")) {
+		if (argc <= 3)
+			exit(EXIT_FAILURE);
+		if (find_opt("stdin")) {
+			if (i2c_dump_file(NULL))
+				exit(EXIT_FAILURE);
+		} else {
+			mon_builtin();
+		}
+		if (monitor(atoi(argv[2]), argv[3], argc > 4 ? atol(argv[4]) : 0, find_opt("csv")))
+			exit(EXIT_FAILURE);
+		exit(EXIT_SUCCESS);
+	}
+	if (argc > 1 && !strcmp(argv[1], "monitor_csv")) {
+		if (monitor_csv())
+			exit(EXIT_FAILURE);
+		exit(EXIT_SUCCESS);
+	}
 	if (argc > 1 && !strcmp(argv[1], "i2c_reg_write")) {
 		if (argc <= 4)
 			exit(EXIT_FAILURE);
@@ -1195,7 +1846,7 @@ main(int _argc, char *_argv[])
 			buf[j-4] = strtol(argv[j], NULL, 0);
 		if (a <= 0 && r < 0)
 			exit(EXIT_FAILURE);
-		i = i2c_reg_write(a, r, buf, j, find_opt("trans"));
+		i = i2c_reg_write(a, r, buf, j - 4, find_opt("trans"));
 		if (i < 0) {
 			printf("Unable to write register 0x%x to addr 0x%x\n", r, a);
 			exit(EXIT_FAILURE);
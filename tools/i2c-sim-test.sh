@@ -0,0 +1,37 @@
+#!/bin/sh
+#
+# axehelper / senddsq against the I2C simulator with two i2c_mangle rules,
+# the message trace and the simulator log are compared with
+# tools/i2c-sim-test.expected
+#
+# usage: i2c-sim-test.sh <i2c-sim.so> <axehelper> <senddsq>
+#
+
+if test $# -ne 3; then
+  echo "usage: $0 <i2c-sim.so> <axehelper> <senddsq>"
+  exit 1
+fi
+SIM=$(readlink -f "$1")
+AXEHELPER=$2
+SENDDSQ=$3
+EXPECTED=$(dirname "$0")/i2c-sim-test.expected
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+export I2CSIM_TRACE=$TMP/trace.txt
+export I2CSIM_LOG=$TMP/log.txt
+# BB gain of the first tuner, PLS/MIS writes before the P2 path merger reset
+export I2CSIM_RULES="mask 0x60 1 0x01 0x01 0x0f 0 8;inject 0x68 2 0xf372 0xd1 0xf350 0x20 0xf35e 0x05"
+
+# CTRL1, CTRL2 - the gain nibble of CTRL2 is replaced
+LD_PRELOAD=$SIM $AXEHELPER i2c_reg_write 0xc0 0x00 0x70 0x31 || exit 1
+LD_PRELOAD=$SIM $AXEHELPER i2c_reg_write 0xd0 0xf372 0xd1 || exit 1
+echo "e0 10 38 f0" | LD_PRELOAD=$SIM $SENDDSQ -f 0 > /dev/null || exit 1
+
+# the file descriptors depend on the environment
+{ cat $I2CSIM_TRACE; grep -v "open('" $I2CSIM_LOG; } > $TMP/out.txt
+if ! diff -u "$EXPECTED" $TMP/out.txt; then
+  echo "i2c-sim-test: FAILED"
+  exit 1
+fi
+echo "i2c-sim-test: OK"
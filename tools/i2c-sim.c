@@ -0,0 +1,724 @@
+/*
+
+STV0900/STV6120 I2C simulator for the AXE boards - run axehelper,
+senddsq and other I2C tools on a host without the hardware.
+The /dev/i2c-0 (/dev/axe/i2c_drv-0) bus is emulated with two STV0900
+demodulators (0xd0, 0xd2) and two STV6120 tuners (0xc0, 0xc6) behind
+the P1 I2C repeaters of the demodulators. The /dev/axe/frontend-N
+DiSEqC ioctls are converted to the DISTX register accesses of the
+stv0900 driver and executed on the same register files.
+
+Compile:
+  gcc -o i2c-sim.o -c -fPIC -Wall -I. i2c-sim.c
+  gcc -o i2c-sim.so -shared -rdynamic i2c-sim.o -ldl -lpthread
+
+Usage:
+   export LD_PRELOAD=/tmp/i2c-sim.so
+   export I2CSIM_REGS=/tmp/regs.txt    # initial register values
+   export I2CSIM_TRACE=/tmp/i2c.txt    # message trace (axehelper i2c_decoder)
+   export I2CSIM_KHZ=400               # simulated bus clock (0 = no delay)
+   export I2CSIM_FRONTEND=0            # do not emulate the frontends
+   export I2CSIM_RULES="mask 0x60 1 0x01 0x01 0x0f 0 8;..."  # i2c_mangle rules
+   export I2CSIM_LOG=/tmp/i2c-sim.log
+   ..run axehelper i2c_dump, senddsq -f 0 ...
+
+Notes:
+   The register file lines are "addr reg val [val ...]" (hex, 8-bit
+   addresses as in axehelper, auto-increment), for example
+   "0xd0 0xf212 0x88" sets DSTATUS of Input_1 to locked.
+   Both address auto-increment and the repeater are emulated as the
+   chips do it: the tuner NACKs unless I2CT_ON is set in P1_I2CRPT and
+   the repeater closes at the first STOP after a tuner access when
+   STOP_ENABLE is set. A message with I2C_M_NOREPSTART or the last
+   message of the transfer ends with STOP. Set I2CSIM_FRONTEND=0 when
+   stacked with axe-replay.so.
+   I2CSIM_RULES takes the lines of the i2c_mangle_rules sysfs file
+   separated by ';', the write messages go through the rule engine of
+   the i2c_mangle module (i2c_mangle_rule.h) before they reach the
+   simulated chips, the trace shows the mangled and injected messages.
+   tools/i2c-sim-test.sh runs axehelper and senddsq against the
+   simulator and compares the trace with tools/i2c-sim-test.expected.
+
+*/
+
+#define _GNU_SOURCE
+#define _LARGEFILE64_SOURCE
+#include <dlfcn.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <linux/dvb/frontend.h>
+
+#if defined(RTLD_NEXT)
+#define REAL_LIBC RTLD_NEXT
+#else
+#define REAL_LIBC ((void *) -1L)
+#endif
+
+#ifndef I2C_M_NOREPSTART
+#define I2C_M_NOREPSTART 0x8000  /* STLinux i2c.h */
+#endif
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+
+#define MAX_NODES 8
+
+#define NODE_I2C      1
+#define NODE_FRONTEND 2
+
+#define DEMODS 2
+
+#define STV0900_BASE     0xf000
+#define STV0900_SIZE     0x1000
+#define STV0900_MID      0xf100
+#define STV0900_P1_I2CRPT 0xf12a
+#define   I2CT_ON        0x80
+#define   STOP_ENABLE    0x04
+#define STV0900_DISTX(path) ((path) ? 0xf1a0 : 0xf190)  /* P1 : P2 */
+#define   DISTXCTL       0
+#define     DISEQC_RESET 0x40
+#define     DIS_PRECHARGE 0x08
+#define     DISTX_MODE   0x07
+#define   DISTXDATA      7
+#define   DISTXSTATUS    8
+#define     TX_IDLE      0x20
+
+#define STV6120_SIZE     0x20
+
+struct diseqc {
+  unsigned char buf[16];
+  int len;
+};
+
+struct demod {
+  int addr;                 /* 7-bit */
+  int ptr;
+  int rpt_used;             /* tuner accessed since the last STOP */
+  unsigned char reg[STV0900_SIZE];
+  struct diseqc dsq[2];
+};
+
+struct tuner {
+  int addr;                 /* 7-bit */
+  int demod;
+  int ptr;
+  unsigned char reg[STV6120_SIZE];
+};
+
+struct node {
+  int type;
+  int fd;
+  int input;
+};
+
+static void rlog(const char *fmt, ...);
+
+#define RULE_DEBUG(fmt, args...) rlog(fmt, ##args)
+
+#include "i2c_mangle_rule.h"
+
+/* Function pointers for real libc versions */
+static int (*real_open)(const char *pathname, int flags, ...);
+static int (*real_open64)(const char *pathname, int flags, ...);
+static int (*real_ioctl)(int fd, unsigned long request, ...);
+static int (*real_close)(int fd);
+
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct node nodes[MAX_NODES];
+static struct demod demods[DEMODS] = { { .addr = 0xd0 >> 1 }, { .addr = 0xd2 >> 1 } };
+static struct tuner tuners[DEMODS] = {
+  { .addr = 0xc0 >> 1, .demod = 0 },
+  { .addr = 0xc6 >> 1, .demod = 1 }
+};
+static int sim_ready;
+static int log_fd = -1;
+static FILE *trace;
+static struct mangle_rule rules[MAX_RULES];
+static int nrules;
+
+static struct {
+  unsigned long transfers;
+  unsigned long msgs;
+  unsigned long bytes;
+  unsigned long nacks;
+  unsigned long long bus_us;
+} stats;
+
+#define REDIR(realptr, symname) do { \
+  if ((realptr) == NULL) { \
+    (realptr) = dlsym(REAL_LIBC, symname); \
+    if ((realptr) == NULL) exit(1001); \
+  } \
+} while (0)
+
+/* log function */
+static void rlog(const char *fmt, ...)
+{
+  char buf[512];
+  va_list ap;
+  int keep_errno = errno;
+
+  if (log_fd < 0) {
+    const char *f = getenv("I2CSIM_LOG");
+    REDIR(real_open, "open");
+    log_fd = f ? real_open(f, O_CREAT|O_APPEND|O_WRONLY, 0600) : 2 /* stderr */;
+    if (log_fd < 0)
+      log_fd = 2;
+  }
+  strcpy(buf, "i2c-sim: ");
+  va_start(ap, fmt);
+  vsnprintf(buf + 9, sizeof(buf) - 9, fmt, ap);
+  va_end(ap);
+  if (write(log_fd, buf, strlen(buf)) < 0) {
+    /* nothing to do */
+  }
+  errno = keep_errno;
+}
+
+static int env_int(const char *name, int def)
+{
+  const char *s = getenv(name);
+  return s ? atoi(s) : def;
+}
+
+static struct node *find_node(int fd)
+{
+  int i;
+
+  if (fd < 0)
+    return NULL;
+  for (i = 0; i < MAX_NODES; i++)
+    if (nodes[i].type && nodes[i].fd == fd)
+      return &nodes[i];
+  return NULL;
+}
+
+static struct demod *find_demod(int addr)
+{
+  int i;
+
+  for (i = 0; i < DEMODS; i++)
+    if (demods[i].addr == addr)
+      return &demods[i];
+  return NULL;
+}
+
+static struct tuner *find_tuner(int addr)
+{
+  int i;
+
+  for (i = 0; i < DEMODS; i++)
+    if (tuners[i].addr == addr)
+      return &tuners[i];
+  return NULL;
+}
+
+/*
+ * Trace in the ivo_i2c text format, the decoder accepts up to 16 bytes
+ * per line so the longer demodulator accesses are split and readdressed
+ * (ptr is the register of m->buf[0]).
+ */
+static void trace_msg(struct i2c_msg *m, int ptr, int nack)
+{
+  int off = 0, cnt, i, rd = (m->flags & I2C_M_RD) != 0;
+
+  if (trace == NULL)
+    return;
+  do {
+    cnt = m->len - off > 16 ? 16 : m->len - off;
+    if (rd && off > 0 && find_demod(m->addr))
+      fprintf(trace, "[i2c] wrte(%02x, 2) %02x.%02x\n",
+              m->addr << 1, ((ptr + off) >> 8) & 0xff, (ptr + off) & 0xff);
+    if (!rd && off > 0 && find_demod(m->addr)) {
+      /* 16 bytes - the 2-byte register address */
+      cnt = m->len - off > 14 ? 14 : m->len - off;
+      fprintf(trace, "[i2c] wrte(%02x, %d) %02x.%02x", m->addr << 1, cnt + 2,
+              ((ptr + off) >> 8) & 0xff, (ptr + off) & 0xff);
+      for (i = 0; i < cnt; i++)
+        fprintf(trace, ".%02x", m->buf[off + i]);
+    } else {
+      fprintf(trace, "[i2c] %s(%02x, %d)", rd ? "read" : "wrte",
+              (m->addr << 1) | rd, cnt);
+      for (i = 0; i < cnt; i++)
+        fprintf(trace, "%s%02x", i > 0 ? "." : " ", m->buf[off + i]);
+    }
+    fprintf(trace, "%s\n", nack ? " NACK" : "");
+    off += cnt;
+  } while (off < m->len);
+  fflush(trace);
+}
+
+static void diseqc_flush(struct demod *d, int path, const char *what)
+{
+  struct diseqc *q = &d->dsq[path];
+  char buf[64];
+  int i;
+
+  if (q->len <= 0)
+    return;
+  for (i = 0, buf[0] = '\0'; i < q->len; i++)
+    sprintf(buf + strlen(buf), " %02x", q->buf[i]);
+  rlog("%02x %s %s:%s\n", d->addr << 1, path ? "P1" : "P2", what, buf);
+  q->len = 0;
+}
+
+static unsigned char demod_read(struct demod *d, int reg)
+{
+  return d->reg[reg & (STV0900_SIZE - 1)];
+}
+
+static void demod_write(struct demod *d, int reg, unsigned char val)
+{
+  unsigned char *r = &d->reg[reg & (STV0900_SIZE - 1)];
+  unsigned char old = *r;
+  int path;
+
+  reg = STV0900_BASE | (reg & (STV0900_SIZE - 1));
+  if (reg == STV0900_MID)
+    return;
+  for (path = 0; path < 2; path++) {
+    if (reg == STV0900_DISTX(path) + DISTXCTL) {
+      *r = val;
+      if ((old & DIS_PRECHARGE) && !(val & DIS_PRECHARGE))
+        diseqc_flush(d, path, "diseqc");
+      if ((val & DISTX_MODE) == 0 && (old & DISEQC_RESET) != (val & DISEQC_RESET))
+        rlog("%02x %s tone %s\n", d->addr << 1, path ? "P1" : "P2",
+             (val & DISEQC_RESET) ? "off" : "on");
+      return;
+    }
+    if (reg == STV0900_DISTX(path) + DISTXDATA) {
+      struct diseqc *q = &d->dsq[path];
+      if (q->len < (int)sizeof(q->buf))
+        q->buf[q->len++] = val;
+      if (!(demod_read(d, STV0900_DISTX(path) + DISTXCTL) & DIS_PRECHARGE))
+        diseqc_flush(d, path, "burst");
+      return;
+    }
+    if (reg == STV0900_DISTX(path) + DISTXSTATUS)
+      return;
+  }
+  *r = val;
+}
+
+/* STOP condition on the bus */
+static void sim_stop(void)
+{
+  struct demod *d;
+  int i;
+
+  for (i = 0; i < DEMODS; i++) {
+    d = &demods[i];
+    if (d->rpt_used && (demod_read(d, STV0900_P1_I2CRPT) & STOP_ENABLE))
+      d->reg[STV0900_P1_I2CRPT - STV0900_BASE] &= ~I2CT_ON;
+    d->rpt_used = 0;
+  }
+}
+
+static int sim_msg(struct i2c_msg *m)
+{
+  struct demod *d;
+  struct tuner *t;
+  int i, ptr = 0;
+
+  if ((d = find_demod(m->addr)) != NULL) {
+    if (m->flags & I2C_M_RD) {
+      ptr = d->ptr;
+      for (i = 0; i < m->len; i++)
+        m->buf[i] = demod_read(d, d->ptr++);
+    } else if (m->len >= 2) {
+      d->ptr = (m->buf[0] << 8) | m->buf[1];
+      ptr = d->ptr - 2;
+      for (i = 2; i < m->len; i++)
+        demod_write(d, d->ptr++, m->buf[i]);
+    }
+  } else if ((t = find_tuner(m->addr)) != NULL) {
+    d = &demods[t->demod];
+    if (!(demod_read(d, STV0900_P1_I2CRPT) & I2CT_ON))
+      goto nack;
+    d->rpt_used = 1;
+    if (m->flags & I2C_M_RD) {
+      for (i = 0; i < m->len; i++)
+        m->buf[i] = t->reg[t->ptr++ % STV6120_SIZE];
+    } else if (m->len >= 1) {
+      t->ptr = m->buf[0];
+      for (i = 1; i < m->len; i++)
+        t->reg[t->ptr++ % STV6120_SIZE] = m->buf[i];
+    }
+  } else {
+    goto nack;
+  }
+  trace_msg(m, ptr, 0);
+  return 0;
+nack:
+  trace_msg(m, 0, 1);
+  stats.nacks++;
+  return -1;
+}
+
+/* i2c_mangle inject_seq(), the messages go to the chips before the transfer */
+static void inject_seq(struct i2c_adapter *adap, struct i2c_msg *src, struct mangle_rule *rule)
+{
+  struct i2c_msg m;
+  u8 buf[3];
+  int r, l;
+
+  for (r = 0; r < rule->nseq; r++) {
+    l = 0;
+    if (rule->reglen == 2)
+      buf[l++] = rule->seq[r][0] >> 8;
+    buf[l++] = rule->seq[r][0];
+    buf[l++] = rule->seq[r][1];
+    m = *src;
+    m.len = l;
+    m.buf = buf;
+    if (sim_msg(&m) < 0)
+      break;
+  }
+  sim_stop();
+}
+
+/* i2c_transfer_axe_mangle() */
+static void sim_mangle(struct i2c_msg *msgs, int num, u8 (*mbuf)[32])
+{
+  struct i2c_msg *m;
+  int i, j;
+
+  for (i = 0; i < num; i++) {
+    m = msgs + i;
+    if (m->len < 1 || (m->flags & (I2C_M_RD | I2C_M_TEN)) != 0)
+      continue;
+    for (j = 0; j < nrules; j++)
+      if (rules[j].addr == m->addr)
+        rule_apply(NULL, &rules[j], m, mbuf[i]);
+  }
+}
+
+/* bus time: START, address + ACK, data + ACK, STOP */
+static unsigned long long sim_bus_us(struct i2c_msg *m, int nmsgs, int khz)
+{
+  unsigned long long bits = 0;
+  int i;
+
+  for (i = 0; i < nmsgs; i++)
+    bits += 2 + 9 * (1 + m[i].len);
+  return khz > 0 ? bits * 1000 / khz : 0;
+}
+
+static int sim_transfer(struct i2c_rdwr_ioctl_data *d)
+{
+  struct i2c_msg msgs[I2C_RDRW_IOCTL_MAX_MSGS];
+  u8 mbuf[I2C_RDRW_IOCTL_MAX_MSGS][32];
+  struct timespec ts;
+  unsigned long long us;
+  unsigned i;
+  int r = 0;
+
+  if (d->nmsgs > I2C_RDRW_IOCTL_MAX_MSGS) {
+    errno = EINVAL;
+    return -1;
+  }
+  /* the mangled messages point to mbuf, the caller's msgs stay intact */
+  memcpy(msgs, d->msgs, d->nmsgs * sizeof(*msgs));
+  pthread_mutex_lock(&sim_lock);
+  if (nrules > 0)
+    sim_mangle(msgs, d->nmsgs, mbuf);
+  stats.transfers++;
+  for (i = 0; i < d->nmsgs; i++) {
+    stats.msgs++;
+    stats.bytes += msgs[i].len;
+    if (sim_msg(&msgs[i]) < 0) {
+      r = -1;
+      break;
+    }
+    if ((msgs[i].flags & I2C_M_NOREPSTART) || i + 1 == d->nmsgs)
+      sim_stop();
+  }
+  if (r < 0)
+    sim_stop();
+  us = sim_bus_us(msgs, r < 0 ? i + 1 : d->nmsgs, env_int("I2CSIM_KHZ", 0));
+  stats.bus_us += us;
+  pthread_mutex_unlock(&sim_lock);
+  if (us > 0) {
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (us % 1000000) * 1000;
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR);
+  }
+  if (r < 0) {
+    errno = EREMOTEIO;
+    return -1;
+  }
+  return d->nmsgs;
+}
+
+static void sim_load(const char *file)
+{
+  struct demod *d;
+  struct tuner *t;
+  char line[512], *s, *e;
+  unsigned long v[34];
+  int i, cnt, lines = 0;
+  FILE *f;
+
+  if ((f = fopen(file, "r")) == NULL) {
+    rlog("unable to open '%s': %s\n", file, strerror(errno));
+    return;
+  }
+  while (fgets(line, sizeof(line), f)) {
+    for (s = line, cnt = 0; cnt < 34; s = e, cnt++) {
+      v[cnt] = strtoul(s, &e, 0);
+      if (e == s)
+        break;
+    }
+    if (line[0] == '#' || cnt < 3)
+      continue;
+    if ((d = find_demod(v[0] >> 1)) != NULL) {
+      for (i = 2; i < cnt; i++)
+        d->reg[(v[1] + i - 2) & (STV0900_SIZE - 1)] = v[i];
+    } else if ((t = find_tuner(v[0] >> 1)) != NULL) {
+      for (i = 2; i < cnt; i++)
+        t->reg[(v[1] + i - 2) % STV6120_SIZE] = v[i];
+    } else {
+      continue;
+    }
+    lines++;
+  }
+  fclose(f);
+  rlog("'%s': %d register lines loaded\n", file, lines);
+}
+
+static void sim_rules(const char *s)
+{
+  struct mangle_rule r;
+  char line[128], cmd[8];
+  int v[13], n;
+  size_t l;
+
+  for (; *s; s += l + (s[l] != '\0')) {
+    l = strcspn(s, ";");
+    snprintf(line, sizeof(line), "%.*s", (int)l, s);
+    memset(v, 0, sizeof(v));
+    n = rule_scan(line, cmd, v);
+    if (n < 0)
+      continue;
+    if (nrules >= MAX_RULES || rule_parse(&r, cmd, v, n) || rule_check(&r)) {
+      rlog("bad rule '%s'\n", line);
+      continue;
+    }
+    rules[nrules++] = r;
+  }
+}
+
+static void sim_init(void)
+{
+  const char *s;
+  int i, path;
+
+  if (sim_ready)
+    return;
+  for (i = 0; i < DEMODS; i++) {
+    demods[i].reg[STV0900_MID - STV0900_BASE] = 0x20;  /* cut 2.0 */
+    for (path = 0; path < 2; path++) {
+      demods[i].reg[STV0900_DISTX(path) + DISTXCTL - STV0900_BASE] = DISEQC_RESET;
+      demods[i].reg[STV0900_DISTX(path) + DISTXSTATUS - STV0900_BASE] = TX_IDLE;
+    }
+  }
+  if ((s = getenv("I2CSIM_REGS")) != NULL)
+    sim_load(s);
+  if ((s = getenv("I2CSIM_RULES")) != NULL)
+    sim_rules(s);
+  if ((s = getenv("I2CSIM_TRACE")) != NULL) {
+    if ((trace = fopen(s, "a")) == NULL)
+      rlog("unable to open '%s': %s\n", s, strerror(errno));
+  }
+  sim_ready = 1;
+}
+
+static int node_open(const char *pathname)
+{
+  struct node *n = NULL;
+  int i, type, input = 0;
+
+  if (!strcmp(pathname, "/dev/i2c-0") || !strcmp(pathname, "/dev/axe/i2c_drv-0"))
+    type = NODE_I2C;
+  else if (sscanf(pathname, "/dev/axe/frontend-%d", &input) == 1 &&
+           env_int("I2CSIM_FRONTEND", 1))
+    type = NODE_FRONTEND;
+  else
+    return -2;
+  if (input < 0 || input >= 2 * DEMODS) {
+    errno = ENOENT;
+    return -1;
+  }
+  pthread_mutex_lock(&sim_lock);
+  sim_init();
+  for (i = 0; i < MAX_NODES; i++)
+    if (nodes[i].type == 0) {
+      n = &nodes[i];
+      break;
+    }
+  if (n == NULL) {
+    pthread_mutex_unlock(&sim_lock);
+    errno = EMFILE;
+    return -1;
+  }
+  n->input = input;
+  n->fd = real_open("/dev/null", O_RDWR);
+  if (n->fd >= 0)
+    n->type = type;
+  pthread_mutex_unlock(&sim_lock);
+  rlog("open('%s') = %d\n", pathname, n->fd);
+  return n->fd;
+}
+
+/* open() wrapper */
+int open(const char *pathname, int flags, ...)
+{
+  va_list ap;
+  mode_t mode = 0;
+  int r;
+
+  REDIR(real_open, "open");
+  REDIR(real_close, "close");
+
+  if ((r = node_open(pathname)) != -2)
+    return r;
+  if (flags & O_CREAT) {
+    va_start(ap, flags);
+    mode = va_arg(ap, mode_t);
+    va_end(ap);
+  }
+  return real_open(pathname, flags, mode);
+}
+
+/* open64() wrapper */
+int open64(const char *pathname, int flags, ...)
+{
+  va_list ap;
+  mode_t mode = 0;
+  int r;
+
+  REDIR(real_open, "open");
+  REDIR(real_open64, "open64");
+  REDIR(real_close, "close");
+
+  if ((r = node_open(pathname)) != -2)
+    return r;
+  if (flags & O_CREAT) {
+    va_start(ap, flags);
+    mode = va_arg(ap, mode_t);
+    va_end(ap);
+  }
+  return real_open64(pathname, flags, mode);
+}
+
+/* close() wrapper */
+int close(int fd)
+{
+  struct node *n;
+  int i;
+
+  REDIR(real_close, "close");
+
+  pthread_mutex_lock(&sim_lock);
+  n = find_node(fd);
+  if (n && n->type == NODE_I2C) {
+    rlog("i2c-0: %lu transfers, %lu messages, %lu bytes, %lu NACKs, bus %llu us\n",
+         stats.transfers, stats.msgs, stats.bytes, stats.nacks, stats.bus_us);
+    for (i = 0; i < nrules; i++)
+      rlog("rule %d: hits %lu injected %lu\n", i, rules[i].hits, rules[i].injected);
+  }
+  if (n)
+    n->type = 0;
+  pthread_mutex_unlock(&sim_lock);
+  return real_close(fd);
+}
+
+/* the register accesses of the stv0900 driver for the frontend node */
+static int fe_ioctl(struct node *n, unsigned long request, void *arg)
+{
+  struct dvb_diseqc_master_cmd *cmd;
+  struct demod *d = &demods[n->input >> 1];
+  int path = n->input & 1, ctl = STV0900_DISTX(path) + DISTXCTL;
+  int i, v;
+
+  pthread_mutex_lock(&sim_lock);
+  switch (request) {
+  case FE_SET_TONE:
+    v = demod_read(d, ctl) & ~DISTX_MODE;
+    demod_write(d, ctl, v | DISEQC_RESET);
+    if ((long)arg == SEC_TONE_ON)
+      demod_write(d, ctl, v & ~DISEQC_RESET);
+    break;
+  case FE_DISEQC_SEND_MASTER_CMD:
+    cmd = arg;
+    v = demod_read(d, ctl);
+    demod_write(d, ctl, v | DIS_PRECHARGE);
+    for (i = 0; i < cmd->msg_len && i < (int)sizeof(cmd->msg); i++)
+      demod_write(d, STV0900_DISTX(path) + DISTXDATA, cmd->msg[i]);
+    demod_write(d, ctl, v & ~DIS_PRECHARGE);
+    break;
+  case FE_DISEQC_SEND_BURST:
+    v = demod_read(d, ctl) & ~DISTX_MODE;
+    demod_write(d, ctl, v | ((long)arg == SEC_MINI_A ? 3 : 2));
+    demod_write(d, STV0900_DISTX(path) + DISTXDATA, (long)arg == SEC_MINI_A ? 0x00 : 0xff);
+    break;
+  case FE_SET_VOLTAGE:
+    rlog("frontend %d: voltage %s\n", n->input,
+         (long)arg == SEC_VOLTAGE_13 ? "13V" : (long)arg == SEC_VOLTAGE_18 ? "18V" : "off");
+    break;
+  default:
+    break;
+  }
+  pthread_mutex_unlock(&sim_lock);
+  return 0;
+}
+
+/* ioctl() wrapper */
+int ioctl(int fd, unsigned long request, ...)
+{
+  struct node *n;
+  va_list ap;
+  void *arg;
+
+  REDIR(real_ioctl, "ioctl");
+
+  va_start(ap, request);
+  arg = va_arg(ap, void *);
+  va_end(ap);
+
+  pthread_mutex_lock(&sim_lock);
+  n = find_node(fd);
+  pthread_mutex_unlock(&sim_lock);
+  if (n == NULL)
+    return real_ioctl(fd, request, arg);
+  if (n->type == NODE_FRONTEND)
+    return fe_ioctl(n, request, arg);
+  switch (request) {
+  case I2C_RDWR:
+    return sim_transfer(arg);
+  case I2C_FUNCS:
+    *(unsigned long *)arg = I2C_FUNC_I2C;
+    return 0;
+  case I2C_SLAVE:
+  case I2C_SLAVE_FORCE:
+  case I2C_TENBIT:
+  case I2C_RETRIES:
+  case I2C_TIMEOUT:
+    return 0;
+  }
+  errno = ENOTTY;
+  return -1;
+}
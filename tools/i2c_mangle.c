@@ -9,8 +9,12 @@
 #include <linux/completion.h>
 #include <linux/hardirq.h>
 #include <linux/irqflags.h>
-#include <linux/rwsem.h>
+#include <linux/spinlock.h>
+#include <linux/bitmap.h>
+#include <linux/workqueue.h>
+#include <linux/jiffies.h>
 #include <asm/uaccess.h>
+#include <asm/atomic.h>
 
 #define STV6120_1 (0xc0 >> 1)
 #define STV6120_2 (0xc6 >> 1)
@@ -26,6 +30,8 @@ static int i2c_mangle_debug = 0;
 static int stv6120_gain = 8;
 static int stv0900_mis[4] = { -1, -1, -1, -1 };
 static int stv0900_pls[4] = { 1, 1, 1, 1 }; /* ROOT code 1 is equal to GOLD code 0 */
+static int i2c_mangle_shadow = 0;
+static int i2c_mangle_repeater = 0;	/* ms, 0 = repeater opened per transfer */
 
 static void i2c_transfer_axe_dump(struct i2c_msg *msgs, int num)
 {
@@ -55,25 +61,656 @@ static void i2c_transfer_axe_dump(struct i2c_msg *msgs, int num)
 	}
 }
 
-static void mangle(u8 *dst, struct i2c_msg *m, int i, int val, int shift, int mask)
+/*
+ * Shadow register cache
+ *
+ * Write-through copy of the demodulator and tuner registers. The data bytes
+ * the chip already holds are trimmed from the start and the end of the write
+ * messages, a message with nothing new is not sent at all (with the repeater
+ * message opening the tuner path for it). Registers with side effects on
+ * write (DiSEqC FIFO, state machine and reset triggers, repeater, counters)
+ * are volatile and always written, a write to a flush register forgets
+ * the whole device.
+ */
+
+#define SHADOW_MAX_DEV		4
+#define SHADOW_MAX_REGS		0x1000
+#define SHADOW_MAX_VOL		32
+#define SHADOW_MAX_FLUSH	4
+#define SHADOW_MSGS		8
+#define SHADOW_BUF		34
+
+#define STV0900_P1_I2CRPT	0xf12a
+#define STV0900_P2_I2CRPT	0xf12b
+
+struct shadow_dev {
+	u8 addr;
+	u8 reglen;
+	u16 base, size;
+	int nvol, nflush;
+	u16 vol[SHADOW_MAX_VOL][2];
+	u16 flush[SHADOW_MAX_FLUSH];
+	unsigned long hits;	/* data bytes not written */
+	unsigned long miss;	/* data bytes written */
+	unsigned long elided;	/* messages not sent */
+	unsigned long flushes;
+	DECLARE_BITMAP(valid, SHADOW_MAX_REGS);
+	u8 val[SHADOW_MAX_REGS];
+};
+
+static DEFINE_SPINLOCK(shadow_lock);
+static struct shadow_dev shadow[SHADOW_MAX_DEV];
+static int shadow_num;
+static u8 shadow_idx[128];		/* device for the address + 1, 0 = none */
+
+static struct shadow_dev *shadow_add(u8 addr, int reglen, int base, int size)
+{
+	struct shadow_dev *d = &shadow[shadow_num++];
+
+	memset(d, 0, sizeof(*d));
+	d->addr = addr;
+	d->reglen = reglen;
+	d->base = base;
+	d->size = size;
+	shadow_idx[addr] = shadow_num;
+	return d;
+}
+
+static void shadow_vol(struct shadow_dev *d, u16 lo, u16 hi)
+{
+	if (d->nvol < SHADOW_MAX_VOL) {
+		d->vol[d->nvol][0] = lo;
+		d->vol[d->nvol++][1] = hi;
+	}
+}
+
+static void shadow_builtin(void)
+{
+	static const u8 tuners[] = { STV6120_1, STV6120_2 };
+	static const u8 demods[] = { STV0900_1, STV0900_2 };
+	struct shadow_dev *d;
+	int i, p;
+
+	for (i = 0; i < ARRAY_SIZE(demods); i++) {
+		d = shadow_add(demods[i], 2, 0xf000, 0x1000);
+		shadow_vol(d, STV0900_P1_I2CRPT, STV0900_P2_I2CRPT);
+		/* both paths, P2 registers are at P1 - 0x200 (DiSEqC at - 0x10) */
+		for (p = 0; p <= 0x200; p += 0x200) {
+			shadow_vol(d, 0xf190 + p / 0x20, 0xf198 + p / 0x20);	/* DISTXCTL..DISTXSTATUS */
+			shadow_vol(d, 0xf216 + p, 0xf216 + p);		/* DMDISTATE */
+			shadow_vol(d, 0xf2c6 + p, 0xf2cf + p);		/* DMDRESCFG..DMDRESDATA0 */
+			shadow_vol(d, 0xf350 + p, 0xf351 + p);		/* PDELCTRL1/2 (ALGOSWRST) */
+			shadow_vol(d, 0xf370 + p, 0xf372 + p);		/* TSSTATEM..TSCFGH (RST_HWARE) */
+			shadow_vol(d, 0xf398 + p, 0xf3ac + p);		/* ERRCNT, FECSPY, FBERCPT */
+		}
+		shadow_vol(d, 0xf630, 0xf630);			/* RST_REEDSOLO */
+		shadow_vol(d, 0xf670, 0xf670);			/* RST1X_REEDSOLO */
+		shadow_vol(d, 0xff00, 0xffff);			/* test registers */
+		/* SYNTCTRL (standby, clocks), TSTRES0 (soft reset) */
+		d->flush[d->nflush++] = 0xf1b6;
+		d->flush[d->nflush++] = 0xff11;
+	}
+	for (i = 0; i < ARRAY_SIZE(tuners); i++) {
+		d = shadow_add(tuners[i], 1, 0x00, 0x20);
+		shadow_vol(d, 0x07, 0x07);	/* STAT1 - calibration start */
+		shadow_vol(d, 0x11, 0x11);	/* STAT2 - calibration start */
+	}
+}
+
+static void shadow_flush(struct shadow_dev *d)
+{
+	bitmap_zero(d->valid, SHADOW_MAX_REGS);
+	d->flushes++;
+}
+
+static int shadow_volatile(struct shadow_dev *d, int reg)
+{
+	int i;
+
+	if (reg < d->base || reg >= d->base + d->size)
+		return 1;
+	for (i = 0; i < d->nvol; i++)
+		if (reg >= d->vol[i][0] && reg <= d->vol[i][1])
+			return 1;
+	for (i = 0; i < d->nflush; i++)
+		if (reg == d->flush[i])
+			return 1;
+	return 0;
+}
+
+static int shadow_same(struct shadow_dev *d, int reg, u8 val)
+{
+	return !shadow_volatile(d, reg) &&
+	       test_bit(reg - d->base, d->valid) &&
+	       d->val[reg - d->base] == val;
+}
+
+static struct shadow_dev *shadow_find(struct i2c_msg *m)
+{
+	int r;
+
+	if ((m->flags & (I2C_M_RD | I2C_M_TEN)) != 0)
+		return NULL;
+	r = shadow_idx[m->addr & 0x7f];
+	if (r == 0 || m->len <= shadow[r - 1].reglen)
+		return NULL;
+	return &shadow[r - 1];
+}
+
+static int shadow_reg(struct shadow_dev *d, struct i2c_msg *m)
+{
+	return d->reglen == 2 ? (m->buf[0] << 8) | m->buf[1] : m->buf[0];
+}
+
+/* a repeater open message which is useless without the next one */
+static int shadow_gate(struct i2c_msg *m)
+{
+	struct shadow_dev *d = shadow_find(m);
+	int reg;
+
+	if (d == NULL || d->reglen != 2 || m->len != 3)
+		return 0;
+	reg = shadow_reg(d, m);
+	return reg == STV0900_P1_I2CRPT || reg == STV0900_P2_I2CRPT;
+}
+
+/*
+ * fill out with the messages to be sent, returns their count
+ */
+static int shadow_filter(struct i2c_msg *msgs, int num,
+			 struct i2c_msg *out, u8 (*buf)[SHADOW_BUF])
 {
-	memcpy(dst, m->buf, m->len);
-	dst[i] &= ~(mask << shift);
-	dst[i] |= (val & mask) << shift;
-	if (i2c_mangle_debug & 2)
-		printk("i2c mangle: i=%d val=0x%x shift=%i mask=0x%x (orig 0x%x new 0x%x)\n",
-			i, val, shift, mask, m->buf[i], dst[i]);
-	if (m->buf[i] != dst[i])
-		m->buf = dst;
+	struct shadow_dev *d;
+	struct i2c_msg *m;
+	int i, a, b, l, reg, n = 0;
+
+	spin_lock(&shadow_lock);
+	for (i = 0; i < num; i++) {
+		m = msgs + i;
+		out[n] = *m;
+		d = shadow_find(m);
+		if (d == NULL || m->len > SHADOW_BUF) {
+			n++;
+			continue;
+		}
+		l = d->reglen;
+		reg = shadow_reg(d, m) - l;
+		/* the first and the last data byte the chip does not hold yet */
+		for (a = l; a < m->len && shadow_same(d, reg + a, m->buf[a]); a++);
+		for (b = m->len - 1; b >= a && shadow_same(d, reg + b, m->buf[b]); b--);
+		d->hits += m->len - l - (b - a + 1);
+		if (a > b) {
+			d->elided++;
+			if (n > 0 && out[n - 1].buf == msgs[i - 1].buf &&
+			    shadow_gate(&out[n - 1]))
+				n--;
+			continue;
+		}
+		d->miss += b - a + 1;
+		if (a > l || b < m->len - 1) {
+			if (l == 2)
+				buf[i][0] = (reg + a) >> 8;
+			buf[i][l - 1] = reg + a;
+			memcpy(&buf[i][l], &m->buf[a], b - a + 1);
+			out[n].buf = buf[i];
+			out[n].len = l + b - a + 1;
+		}
+		n++;
+	}
+	spin_unlock(&shadow_lock);
+	return n;
 }
 
-#define REG_SET3(b1, b2, b3) \
-	do { buf[num][0] = b1; buf[num][1] = b2; buf[num][2] = b3; num++; } while (0)
+/*
+ * remember what was written, ok == 0 means the transfer failed and
+ * the registers of the involved devices are unknown
+ */
+static void shadow_store(struct i2c_msg *msgs, int num, int ok)
+{
+	struct shadow_dev *d;
+	struct i2c_msg *m;
+	int i, j, k, reg;
+
+	spin_lock(&shadow_lock);
+	for (i = 0; i < num; i++) {
+		m = msgs + i;
+		d = shadow_find(m);
+		if (d == NULL)
+			continue;
+		if (!ok) {
+			shadow_flush(d);
+			continue;
+		}
+		reg = shadow_reg(d, m);
+		for (j = d->reglen; j < m->len; j++, reg++) {
+			for (k = 0; k < d->nflush; k++)
+				if (reg == d->flush[k])
+					shadow_flush(d);
+			if (shadow_volatile(d, reg))
+				continue;
+			d->val[reg - d->base] = m->buf[j];
+			__set_bit(reg - d->base, d->valid);
+		}
+	}
+	spin_unlock(&shadow_lock);
+}
 
-static void demod_set_pls_and_mis(struct i2c_adapter *adap, struct i2c_msg *src, int p)
+static void shadow_flush_all(void)
 {
-	struct i2c_msg m[6];
-	u8 buf[6][3];
+	int i;
+
+	spin_lock(&shadow_lock);
+	for (i = 0; i < shadow_num; i++)
+		shadow_flush(&shadow[i]);
+	spin_unlock(&shadow_lock);
+}
+
+/*
+ * Tuner repeater
+ *
+ * The STV6120 tuners are reached through the I2C repeater of the demodulator
+ * in front of them. The repeater opened with STOP_ENABLE closes itself on
+ * the next STOP, so every tuner access used to carry its own I2CRPT write.
+ * Here the repeater is opened without STOP_ENABLE and is kept open while the
+ * tuner is being talked to: the I2CRPT writes in front of the tuner messages
+ * are dropped while it is open, bare tuner messages get one inserted while
+ * it is closed. It is closed from a work item i2c_mangle_repeater ms after
+ * the last tuner access.
+ */
+
+#define RPT_I2CT_ON		0x80
+#define RPT_STOP_ENABLE		0x04
+
+struct repeater {
+	u8 tuner;
+	u8 demod;
+	u16 reg;
+	u8 open;		/* kept open by us */
+	u8 dirty;		/* state unknown after an error */
+	u8 used;		/* used by the current transfer */
+	u8 buf[3];		/* the open message */
+	unsigned long last;	/* jiffies of the last tuner access */
+	unsigned long opens, reused, inserted, closes;
+};
+
+static DEFINE_MUTEX(rpt_mutex);
+static struct repeater rpt[2] = {
+	{ .tuner = STV6120_1, .demod = STV0900_1, .reg = STV0900_P1_I2CRPT,
+	  .buf = { STV0900_P1_I2CRPT >> 8, STV0900_P1_I2CRPT & 0xff, 0xbc } },
+	{ .tuner = STV6120_2, .demod = STV0900_2, .reg = STV0900_P1_I2CRPT,
+	  .buf = { STV0900_P1_I2CRPT >> 8, STV0900_P1_I2CRPT & 0xff, 0xbc } },
+};
+
+static void repeater_close_work(struct work_struct *work);
+static DECLARE_DELAYED_WORK(rpt_work, repeater_close_work);
+
+/*
+ * The transfers may come from atomic context where i2c_transfer2() only
+ * tries the bus lock, do the same here.
+ */
+static int repeater_lock(void)
+{
+	if (in_atomic() || irqs_disabled())
+		return mutex_trylock(&rpt_mutex) ? 0 : -EAGAIN;
+	mutex_lock(&rpt_mutex);
+	return 0;
+}
+
+static struct repeater *repeater_tuner(struct i2c_msg *m)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(rpt); i++)
+		if (m->addr == rpt[i].tuner)
+			return &rpt[i];
+	return NULL;
+}
+
+static struct repeater *repeater_msg(struct i2c_msg *m)
+{
+	int i;
+
+	if ((m->flags & I2C_M_RD) != 0 || m->len != 3)
+		return NULL;
+	for (i = 0; i < ARRAY_SIZE(rpt); i++)
+		if (m->addr == rpt[i].demod &&
+		    ((m->buf[0] << 8) | m->buf[1]) == rpt[i].reg)
+			return &rpt[i];
+	return NULL;
+}
+
+/*
+ * rewrite the messages in out, returns their count, called with rpt_mutex
+ */
+static int repeater_filter(struct i2c_msg *out, int n)
+{
+	struct i2c_msg in[SHADOW_MSGS];
+	struct repeater *rp;
+	struct i2c_msg *m;
+	int i, j = 0;
+
+	memcpy(in, out, n * sizeof(*in));
+	for (i = 0; i < n; i++) {
+		m = &in[i];
+		rp = repeater_msg(m);
+		if (rp) {
+			rp->used = 1;
+			if (!(m->buf[2] & RPT_I2CT_ON) ||
+			    i + 1 >= n || repeater_tuner(&in[i + 1]) != rp) {
+				/* somebody else drives the repeater */
+				rp->open = 0;
+			} else if (rp->open) {
+				rp->reused++;
+				continue;
+			} else {
+				rp->buf[2] = m->buf[2] & ~RPT_STOP_ENABLE;
+				m->buf = rp->buf;
+				rp->open = 1;
+				rp->opens++;
+			}
+			out[j++] = *m;
+			continue;
+		}
+		rp = repeater_tuner(m);
+		if (rp) {
+			rp->used = 1;
+			if (!rp->open) {
+				out[j] = *m;
+				out[j].addr = rp->demod;
+				out[j].flags &= ~I2C_M_RD;
+				out[j].len = sizeof(rp->buf);
+				rp->buf[2] &= ~RPT_STOP_ENABLE;
+				out[j++].buf = rp->buf;
+				rp->open = 1;
+				rp->inserted++;
+			}
+		}
+		out[j++] = *m;
+	}
+	return j;
+}
+
+static void repeater_done(int ok)
+{
+	int i, arm = 0;
+
+	for (i = 0; i < ARRAY_SIZE(rpt); i++) {
+		if (!rpt[i].used)
+			continue;
+		rpt[i].used = 0;
+		rpt[i].last = jiffies;
+		if (!ok) {
+			rpt[i].open = 0;
+			rpt[i].dirty = 1;
+		}
+		arm |= rpt[i].open || rpt[i].dirty;
+	}
+	if (arm)
+		schedule_delayed_work(&rpt_work, msecs_to_jiffies(i2c_mangle_repeater));
+}
+
+static void repeater_close_work(struct work_struct *work)
+{
+	unsigned long timeout = msecs_to_jiffies(i2c_mangle_repeater);
+	unsigned long next = 0;
+	struct i2c_msg m;
+	u8 buf[3];
+	int i, r;
+
+	mutex_lock(&rpt_mutex);
+	for (i = 0; i < ARRAY_SIZE(rpt); i++) {
+		if (!rpt[i].open && !rpt[i].dirty)
+			continue;
+		if (i2c_mangle_repeater > 0 &&
+		    time_before(jiffies, rpt[i].last + timeout)) {
+			if (!next || time_before(rpt[i].last + timeout, next))
+				next = rpt[i].last + timeout;
+			continue;
+		}
+		buf[0] = rpt[i].reg >> 8;
+		buf[1] = rpt[i].reg;
+		buf[2] = (rpt[i].buf[2] & ~RPT_I2CT_ON) | RPT_STOP_ENABLE;
+		m.addr = rpt[i].demod;
+		m.flags = 0;
+		m.len = sizeof(buf);
+		m.buf = buf;
+		r = i2c_transfer2(i2c_adapter0, &m, 1);
+		if (r < 0)
+			printk("i2c mangle repeater close error! (%d)\n", r);
+		rpt[i].open = rpt[i].dirty = 0;
+		rpt[i].closes++;
+	}
+	if (next)
+		schedule_delayed_work(&rpt_work, next - jiffies);
+	mutex_unlock(&rpt_mutex);
+}
+
+static int i2c_transfer_axe_filter(struct i2c_adapter *adap, struct i2c_msg *msgs, int num)
+{
+	struct i2c_msg out[2 * SHADOW_MSGS];
+	u8 buf[SHADOW_MSGS][SHADOW_BUF];
+	struct repeater *rp;
+	int n, r, rep = i2c_mangle_repeater > 0;
+
+	if (num > SHADOW_MSGS) {
+		if (i2c_mangle_debug & 1)
+			i2c_transfer_axe_dump(msgs, num);
+		if (rep) {
+			/* the transfer opens and closes the repeater itself */
+			if (repeater_lock())
+				return -EAGAIN;
+			for (n = 0; n < num; n++)
+				if ((rp = repeater_msg(&msgs[n])) != NULL)
+					rp->open = 0;
+		}
+		r = i2c_transfer2(adap, msgs, num);
+		if (rep)
+			mutex_unlock(&rpt_mutex);
+		if (i2c_mangle_shadow)
+			shadow_store(msgs, num, r == num);
+		return r;
+	}
+	if (i2c_mangle_shadow) {
+		n = shadow_filter(msgs, num, out, buf);
+	} else {
+		memcpy(out, msgs, num * sizeof(*out));
+		n = num;
+	}
+	if (rep) {
+		if (repeater_lock())
+			return -EAGAIN;
+		n = repeater_filter(out, n);
+	}
+	if (i2c_mangle_debug & 1)
+		i2c_transfer_axe_dump(out, n);
+	r = n > 0 ? i2c_transfer2(adap, out, n) : 0;
+	if (rep) {
+		repeater_done(r == n);
+		mutex_unlock(&rpt_mutex);
+	}
+	if (i2c_mangle_shadow)
+		shadow_store(msgs, num, r == n);
+	return r == n ? num : r;
+}
+
+/*
+ * Rule engine
+ *
+ * The rules are kept in a table, the rules for one I2C address are chained
+ * from idx[addr], so a transfer to a device without rules costs one lookup.
+ * The transfer hook may run in atomic context and must not wait for a sysfs
+ * writer: the writers modify a copy of the table and swap the pointer under
+ * rules_lock, the hook keeps a reference to the table it works on. The hits
+ * counted by the transfers still running on the replaced table are lost.
+ * The rules themselves are in i2c_mangle_rule.h, shared with i2c-sim.c.
+ */
+
+#define RULE_DEBUG(fmt, args...) \
+	do { if (i2c_mangle_debug & 2) printk(fmt, ##args); } while (0)
+
+#include "i2c_mangle_rule.h"
+
+struct rule_table {
+	atomic_t ref;
+	struct mangle_rule rules[MAX_RULES];
+	u8 idx[128];		/* first rule for the address + 1, 0 = none */
+};
+
+static DEFINE_SPINLOCK(rules_lock);
+static DEFINE_MUTEX(rules_mutex);	/* serialises the writers */
+static struct rule_table *rules_cur;
+static unsigned long stat_msgs, stat_miss;
+
+static void demod_set_pls_and_mis(struct i2c_adapter *adap, struct i2c_msg *src, struct mangle_rule *rule);
+
+static struct rule_table *rules_get(void)
+{
+	struct rule_table *t;
+	unsigned long flags;
+
+	spin_lock_irqsave(&rules_lock, flags);
+	t = rules_cur;
+	atomic_inc(&t->ref);
+	spin_unlock_irqrestore(&rules_lock, flags);
+	return t;
+}
+
+static void rules_put(struct rule_table *t)
+{
+	if (atomic_dec_and_test(&t->ref))
+		kfree(t);
+}
+
+/* a private copy of the current table, called with rules_mutex */
+static struct rule_table *rules_copy(void)
+{
+	struct rule_table *t = kmalloc(sizeof(*t), GFP_KERNEL);
+
+	if (t) {
+		memcpy(t, rules_cur, sizeof(*t));
+		atomic_set(&t->ref, 1);
+	}
+	return t;
+}
+
+/* replace the current table with t, called with rules_mutex */
+static void rules_swap(struct rule_table *t)
+{
+	struct rule_table *old;
+	unsigned long flags;
+
+	spin_lock_irqsave(&rules_lock, flags);
+	old = rules_cur;
+	rules_cur = t;
+	spin_unlock_irqrestore(&rules_lock, flags);
+	rules_put(old);
+}
+
+static void rules_reindex(struct rule_table *t)
+{
+	struct mangle_rule *rules = t->rules;
+	int i;
+
+	memset(t->idx, 0, sizeof(t->idx));
+	for (i = MAX_RULES - 1; i >= 0; i--) {
+		if (rules[i].type == 0)
+			continue;
+		rules[i].next = t->idx[rules[i].addr];
+		t->idx[rules[i].addr] = i + 1;
+	}
+}
+
+static int rule_add(struct rule_table *t, struct mangle_rule *r)
+{
+	struct mangle_rule *rules = t->rules;
+	int i;
+
+	if (rule_check(r))
+		return -EINVAL;
+	for (i = 0; i < MAX_RULES; i++)
+		if (rules[i].type == 0)
+			break;
+	if (i >= MAX_RULES)
+		return -ENOSPC;
+	rules[i] = *r;
+	rules[i].hits = rules[i].injected = 0;
+	rules_reindex(t);
+	return i;
+}
+
+static void rules_builtin(struct rule_table *t)
+{
+	static const u8 tuners[] = { STV6120_1, STV6120_2 };
+	static const u8 demods[] = { STV0900_1, STV0900_2 };
+	struct mangle_rule r;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(tuners); i++) {
+		/* STV6120 CTRL2/CTRL11 - BB gain */
+		memset(&r, 0, sizeof(r));
+		r.type = RULE_MASK;
+		r.addr = tuners[i];
+		r.reglen = 1;
+		r.reg_lo = r.reg_hi = 0x01;
+		r.mask = 0x0f;
+		r.var = &stv6120_gain;
+		rule_add(t, &r);
+		r.reg_lo = r.reg_hi = 0x0b;
+		rule_add(t, &r);
+	}
+	for (i = 0; i < ARRAY_SIZE(demods); i++) {
+		/* inject pls/mis settings before TSCFGH path merger reset */
+		memset(&r, 0, sizeof(r));
+		r.type = RULE_INJECT;
+		r.addr = demods[i];
+		r.reglen = 2;
+		r.reg_lo = r.reg_hi = 0xf372;
+		r.val = 0xd1;
+		r.inject = demod_set_pls_and_mis;
+		rule_add(t, &r);
+		r.reg_lo = r.reg_hi = 0xf572;
+		rule_add(t, &r);
+	}
+}
+
+static void inject_seq(struct i2c_adapter *adap, struct i2c_msg *src, struct mangle_rule *rule)
+{
+	struct i2c_msg m[MAX_INJECT];
+	u8 buf[MAX_INJECT][3];
+	int r, l;
+
+	for (r = 0; r < rule->nseq; r++) {
+		l = 0;
+		if (rule->reglen == 2)
+			buf[r][l++] = rule->seq[r][0] >> 8;
+		buf[r][l++] = rule->seq[r][0];
+		buf[r][l++] = rule->seq[r][1];
+		m[r] = *src;
+		m[r].len = l;
+		m[r].buf = buf[r];
+	}
+	if (i2c_mangle_debug & 1)
+		i2c_transfer_axe_dump(m, rule->nseq);
+	r = i2c_transfer2(adap, m, rule->nseq);
+	if (r < 0)
+		printk("i2c mangle inject error! (%d)\n", r);
+	if (i2c_mangle_shadow)
+		shadow_store(m, rule->nseq, r == rule->nseq);
+}
+
+/* the STV0900 auto-increments the register address, contiguous registers go in one message */
+#define REG_SET(b1, b2, vals...) \
+	do { u8 __v[] = { vals }; \
+	     buf[num][0] = b1; buf[num][1] = b2; \
+	     memcpy(&buf[num][2], __v, sizeof(__v)); \
+	     len[num++] = 2 + sizeof(__v); } while (0)
+
+static void demod_set_pls_and_mis(struct i2c_adapter *adap, struct i2c_msg *src, struct mangle_rule *rule)
+{
+	struct i2c_msg m[3];
+	u8 buf[3][5];
+	int len[3];
+	int p = src->buf[0] == 0xf3;
 	int num = 0, r, mis, idx = p ? 1 : 0;
 	u32 pls;
 	u8 iaddr = p ? 0xf3 : 0xf5;
@@ -87,30 +724,27 @@ static void demod_set_pls_and_mis(struct i2c_adapter *adap, struct i2c_msg *src,
 	mis = stv0900_mis[idx];
 	if (mis >= 0 && mis <= 255) {
 		/* PDELCTRL1 - enable filter */
-		REG_SET3(iaddr, 0x50, 0x20);
-		/* ISIENTRY */
-		REG_SET3(iaddr, 0x5e, mis);
-		/* ISIBITENA */
-		REG_SET3(iaddr, 0x5f, 0xff);
+		REG_SET(iaddr, 0x50, 0x20);
+		/* ISIENTRY, ISIBITENA */
+		REG_SET(iaddr, 0x5e, mis, 0xff);
 	} else {
 		/* SWRST */
-		REG_SET3(iaddr, 0x72, 0xd1);
+		REG_SET(iaddr, 0x72, 0xd1);
 		/* PDELCTRL1 - disable filter */
-		REG_SET3(iaddr, 0x50, 0x00);
+		REG_SET(iaddr, 0x50, 0x00);
 	}
 
 	/* set PLS code and mode (upper three bits) */
 	pls = stv0900_pls[idx];
-	REG_SET3(iaddr-1, 0xae, pls);			/* PLROOT0 */
-	REG_SET3(iaddr-1, 0xad, pls >> 8);		/* PLROOT1 */
-	REG_SET3(iaddr-1, 0xac, (pls >> 16) & 0x0f);	/* PLROOT3 */
+	/* PLROOT2, PLROOT1, PLROOT0 */
+	REG_SET(iaddr-1, 0xac, (pls >> 16) & 0x0f, pls >> 8, pls);
 	if (i2c_mangle_debug & 4)
 		printk("i2c idx=%d: pls=%d mode=%d mis=%d\n", idx,
 			pls & 0x3ffff, (pls >> 18) & 3, mis);
 
 	for (r = 0; r < num; r++) {
 		m[r] = *src;
-		m[r].len = 3;
+		m[r].len = len[r];
 		m[r].buf = buf[r];
 	}
 	if (i2c_mangle_debug & 1)
@@ -118,30 +752,33 @@ static void demod_set_pls_and_mis(struct i2c_adapter *adap, struct i2c_msg *src,
 	r = i2c_transfer2(adap, m, num);
 	if (r < 0)
 		printk("i2c mangle demod pls and mis error! (%d)\n", r);
+	else
+		rule->injected += num;
+	if (i2c_mangle_shadow)
+		shadow_store(m, num, r == num);
 }
 
 static void i2c_transfer_axe_mangle(struct i2c_adapter *adap, struct i2c_msg *msgs, int num)
 {
 	static u8 mbuf[4][32];
+	struct rule_table *t = rules_get();
 	struct i2c_msg *m;
-	int ret, r, i;
+	int ret, r;
 
 	for (ret = 0; ret < num && ret < ARRAY_SIZE(mbuf); ret++) {
 		m = msgs + ret;
-		if (m->len < 1 || (m->flags & I2C_M_RD) != 0)
+		if (m->len < 1 || (m->flags & (I2C_M_RD | I2C_M_TEN)) != 0)
+			continue;
+		stat_msgs++;
+		r = t->idx[m->addr & 0x7f];
+		if (r == 0) {
+			stat_miss++;
 			continue;
-		if (m->addr == STV6120_1 || m->addr == STV6120_2) {
-			for (r = m->buf[0], i = 1; i < m->len; i++, r++)
-				if (r == 0x01 || r == 0x0b)
-					mangle(mbuf[ret], m, i, stv6120_gain, 0, 0x0f);
-		} else if (m->addr == STV0900_1 || m->addr == STV0900_2) {
-			/* inject pls/mis settings before TSCFGH path merger reset */
-			if (m->flags == 0 && m->len == 3 &&
-			    (m->buf[0] == 0xf3 || m->buf[0] == 0xf5) &&
-			    m->buf[1] == 0x72 && m->buf[2] == 0xd1)
-				demod_set_pls_and_mis(adap, m, m->buf[0] == 0xf3);
 		}
+		for (; r; r = t->rules[r - 1].next)
+			rule_apply(adap, &t->rules[r - 1], m, mbuf[ret]);
 	}
+	rules_put(t);
 }
 
 static int i2c_transfer_axe(struct i2c_adapter *adap, struct i2c_msg *msgs, int num)
@@ -149,6 +786,8 @@ static int i2c_transfer_axe(struct i2c_adapter *adap, struct i2c_msg *msgs, int
 	if (adap == i2c_adapter0) {
 		if (i2c_mangle_enable)
 			i2c_transfer_axe_mangle(adap, msgs, num);
+		if (i2c_mangle_shadow || i2c_mangle_repeater > 0)
+			return i2c_transfer_axe_filter(adap, msgs, num);
 		if (i2c_mangle_debug & 1)
 			i2c_transfer_axe_dump(msgs, num);
 	}
@@ -159,258 +798,340 @@ static int i2c_transfer_axe(struct i2c_adapter *adap, struct i2c_msg *msgs, int
  *
  */
 
-static ssize_t i2c_mangle_enable_show
-  (struct device *dev, struct device_attribute *attr, char *page)
-{
-	return sprintf(page, "%u\n", i2c_mangle_enable);
-}
-
-static ssize_t i2c_mangle_enable_store
-  (struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
-{
-	int val = 0;
-	if (sscanf(buf, "%u", &val) != 1)
-		return -EINVAL;
-	i2c_mangle_enable = val;
-	return count;
-}
+#define MANGLE_ATTR(name, var, fmt) \
+static ssize_t name##_show \
+  (struct device *dev, struct device_attribute *attr, char *page) \
+{ \
+	return sprintf(page, fmt "\n", var); \
+} \
+static ssize_t name##_store \
+  (struct device *dev, struct device_attribute *attr, const char *buf, size_t count) \
+{ \
+	int val = 0; \
+	if (sscanf(buf, fmt, &val) != 1) \
+		return -EINVAL; \
+	var = val; \
+	return count; \
+} \
+static DEVICE_ATTR(name, 0644, name##_show, name##_store);
 
-static DEVICE_ATTR(i2c_mangle_enable, 0644,
-		   i2c_mangle_enable_show,
-		   i2c_mangle_enable_store);
+MANGLE_ATTR(i2c_mangle_enable, i2c_mangle_enable, "%u")
+MANGLE_ATTR(i2c_mangle_debug, i2c_mangle_debug, "%u")
+MANGLE_ATTR(stv6120_gain, stv6120_gain, "%u")
+MANGLE_ATTR(stv0900_mis1, stv0900_mis[0], "%i")
+MANGLE_ATTR(stv0900_mis2, stv0900_mis[1], "%i")
+MANGLE_ATTR(stv0900_mis3, stv0900_mis[2], "%i")
+MANGLE_ATTR(stv0900_mis4, stv0900_mis[3], "%i")
+MANGLE_ATTR(stv0900_pls1, stv0900_pls[0], "%i")
+MANGLE_ATTR(stv0900_pls2, stv0900_pls[1], "%i")
+MANGLE_ATTR(stv0900_pls3, stv0900_pls[2], "%i")
+MANGLE_ATTR(stv0900_pls4, stv0900_pls[3], "%i")
 
-static ssize_t i2c_mangle_debug_show
+/*
+ * i2c_mangle_rules
+ *
+ * read: one rule per line with the hit and injected write counters
+ * write:
+ *   mask <addr> <reglen> <reg_lo> <reg_hi> <mask> <shift> <val>
+ *   inject <addr> <reglen> <reg> <val> <reg1> <val1> [... <reg4> <val4>]
+ *   del <id>
+ *   reset - clear the counters
+ * the address is the 7-bit I2C address, the numbers may be given in hex (0x)
+ */
+static ssize_t i2c_mangle_rules_show
   (struct device *dev, struct device_attribute *attr, char *page)
 {
-	return sprintf(page, "%u\n", i2c_mangle_debug);
-}
+	struct rule_table *t = rules_get();
+	struct mangle_rule *r;
+	int i, j, l = 0;
 
-static ssize_t i2c_mangle_debug_store
-  (struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
-{
-	int val = 0;
-	if (sscanf(buf, "%u", &val) != 1)
-		return -EINVAL;
-	i2c_mangle_debug = val;
-	return count;
-}
-
-static DEVICE_ATTR(i2c_mangle_debug, 0644,
-		   i2c_mangle_debug_show,
-		   i2c_mangle_debug_store);
-
-static ssize_t stv6120_gain_show
-  (struct device *dev, struct device_attribute *attr, char *page)
-{
-	return sprintf(page, "%u\n", stv6120_gain);
+	l += scnprintf(page + l, PAGE_SIZE - l, "msgs %lu miss %lu\n", stat_msgs, stat_miss);
+	for (i = 0; i < MAX_RULES; i++) {
+		r = &t->rules[i];
+		if (r->type == RULE_MASK) {
+			l += scnprintf(page + l, PAGE_SIZE - l,
+				"%d mask 0x%02x %d 0x%x 0x%x 0x%02x %d %d%s hits %lu\n",
+				i, r->addr, r->reglen, r->reg_lo, r->reg_hi,
+				r->mask, r->shift, r->var ? *r->var : r->val,
+				r->var ? " (param)" : "", r->hits);
+		} else if (r->type == RULE_INJECT) {
+			l += scnprintf(page + l, PAGE_SIZE - l, "%d inject 0x%02x %d 0x%x 0x%02x",
+				i, r->addr, r->reglen, r->reg_lo, r->val);
+			if (r->inject)
+				l += scnprintf(page + l, PAGE_SIZE - l, " (builtin)");
+			for (j = 0; j < r->nseq; j++)
+				l += scnprintf(page + l, PAGE_SIZE - l, " 0x%x 0x%02x",
+					       r->seq[j][0], r->seq[j][1]);
+			l += scnprintf(page + l, PAGE_SIZE - l, " hits %lu injected %lu\n",
+				       r->hits, r->injected);
+		}
+	}
+	rules_put(t);
+	return l;
 }
 
-static ssize_t stv6120_gain_store
+static ssize_t i2c_mangle_rules_store
   (struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
 {
-	int val = 0;
-	if (sscanf(buf, "%u", &val) != 1)
-		return -EINVAL;
-	stv6120_gain = val;
-	return count;
-}
-
-static DEVICE_ATTR(stv6120_gain, 0644,
-		   stv6120_gain_show,
-		   stv6120_gain_store);
-
-static ssize_t stv0900_mis1_show
-  (struct device *dev, struct device_attribute *attr, char *page)
-{
-	return sprintf(page, "%i\n", stv0900_mis[0]);
-}
+	struct rule_table *t;
+	struct mangle_rule r;
+	int v[13];
+	char cmd[8];
+	int i, n, ret = 0;
 
-static ssize_t stv0900_mis1_store
-  (struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
-{
-	int val = 0;
-	if (sscanf(buf, "%i", &val) != 1)
+	memset(v, 0, sizeof(v));
+	n = rule_scan(buf, cmd, v);
+	if (n < 0)
 		return -EINVAL;
-	stv0900_mis[0] = val;
-	return count;
+	mutex_lock(&rules_mutex);
+	t = rules_copy();
+	if (t == NULL) {
+		ret = -ENOMEM;
+	} else if (!strcmp(cmd, "mask") || !strcmp(cmd, "inject")) {
+		ret = rule_parse(&r, cmd, v, n);
+		if (ret == 0)
+			ret = rule_add(t, &r);
+	} else if (!strcmp(cmd, "del") && n == 1) {
+		if (v[0] >= 0 && v[0] < MAX_RULES && t->rules[v[0]].type) {
+			t->rules[v[0]].type = 0;
+			rules_reindex(t);
+		} else {
+			ret = -ENOENT;
+		}
+	} else if (!strcmp(cmd, "reset") && n == 0) {
+		for (i = 0; i < MAX_RULES; i++)
+			t->rules[i].hits = t->rules[i].injected = 0;
+		stat_msgs = stat_miss = 0;
+	} else {
+		ret = -EINVAL;
+	}
+	if (t != NULL) {
+		if (ret < 0)
+			kfree(t);
+		else
+			rules_swap(t);
+	}
+	mutex_unlock(&rules_mutex);
+	return ret < 0 ? ret : count;
 }
 
-static DEVICE_ATTR(stv0900_mis1, 0644,
-		   stv0900_mis1_show,
-		   stv0900_mis1_store);
+static DEVICE_ATTR(i2c_mangle_rules, 0644,
+		   i2c_mangle_rules_show,
+		   i2c_mangle_rules_store);
 
-static ssize_t stv0900_mis2_show
+/*
+ * i2c_mangle_shadow
+ *
+ * read: the cache state and the hit (bytes not written), miss (bytes written),
+ *       elided (messages not sent) and flush counters per device
+ * write:
+ *   1 / 0 - enable / disable the cache (enabling starts with an empty cache)
+ *   flush - forget all cached registers
+ *   volatile <addr> <reg_lo> <reg_hi> - never cache these registers
+ *   reset - clear the counters
+ */
+static ssize_t i2c_mangle_shadow_show
   (struct device *dev, struct device_attribute *attr, char *page)
 {
-	return sprintf(page, "%i\n", stv0900_mis[1]);
-}
-
-static ssize_t stv0900_mis2_store
-  (struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
-{
-	int val = 0;
-	if (sscanf(buf, "%i", &val) != 1)
-		return -EINVAL;
-	stv0900_mis[1] = val;
-	return count;
-}
-
-static DEVICE_ATTR(stv0900_mis2, 0644,
-		   stv0900_mis2_show,
-		   stv0900_mis2_store);
+	struct shadow_dev *d;
+	int i, j, l = 0;
 
-static ssize_t stv0900_mis3_show
-  (struct device *dev, struct device_attribute *attr, char *page)
-{
-	return sprintf(page, "%i\n", stv0900_mis[2]);
+	spin_lock(&shadow_lock);
+	l += scnprintf(page + l, PAGE_SIZE - l, "enable %d\n", i2c_mangle_shadow);
+	for (i = 0; i < shadow_num; i++) {
+		d = &shadow[i];
+		l += scnprintf(page + l, PAGE_SIZE - l,
+			"0x%02x cached %d hits %lu miss %lu elided %lu flushes %lu volatile",
+			d->addr, bitmap_weight(d->valid, SHADOW_MAX_REGS),
+			d->hits, d->miss, d->elided, d->flushes);
+		for (j = 0; j < d->nvol; j++)
+			l += scnprintf(page + l, PAGE_SIZE - l, " 0x%x-0x%x",
+				       d->vol[j][0], d->vol[j][1]);
+		l += scnprintf(page + l, PAGE_SIZE - l, "\n");
+	}
+	spin_unlock(&shadow_lock);
+	return l;
 }
 
-static ssize_t stv0900_mis3_store
+static ssize_t i2c_mangle_shadow_store
   (struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
 {
-	int val = 0;
-	if (sscanf(buf, "%i", &val) != 1)
-		return -EINVAL;
-	stv0900_mis[2] = val;
-	return count;
-}
-
-static DEVICE_ATTR(stv0900_mis3, 0644,
-		   stv0900_mis3_show,
-		   stv0900_mis3_store);
-
-static ssize_t stv0900_mis4_show
-  (struct device *dev, struct device_attribute *attr, char *page)
-{
-	return sprintf(page, "%i\n", stv0900_mis[3]);
-}
+	struct shadow_dev *d;
+	char cmd[10];
+	int v[3], i, n, ret = 0;
 
-static ssize_t stv0900_mis4_store
-  (struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
-{
-	int val = 0;
-	if (sscanf(buf, "%i", &val) != 1)
+	n = sscanf(buf, "%9s %i %i %i", cmd, &v[0], &v[1], &v[2]) - 1;
+	if (n < 0)
 		return -EINVAL;
-	stv0900_mis[3] = val;
-	return count;
+	if (!strcmp(cmd, "1") && n == 0) {
+		if (!i2c_mangle_shadow)
+			shadow_flush_all();
+		i2c_mangle_shadow = 1;
+	} else if (!strcmp(cmd, "0") && n == 0) {
+		i2c_mangle_shadow = 0;
+	} else if (!strcmp(cmd, "flush") && n == 0) {
+		shadow_flush_all();
+	} else if (!strcmp(cmd, "volatile") && n == 3) {
+		spin_lock(&shadow_lock);
+		if (v[0] >= 0 && v[0] <= 0x7f && shadow_idx[v[0]]) {
+			d = &shadow[shadow_idx[v[0]] - 1];
+			if (d->nvol < SHADOW_MAX_VOL && v[1] <= v[2])
+				shadow_vol(d, v[1], v[2]);
+			else
+				ret = -ENOSPC;
+		} else {
+			ret = -ENOENT;
+		}
+		spin_unlock(&shadow_lock);
+	} else if (!strcmp(cmd, "reset") && n == 0) {
+		spin_lock(&shadow_lock);
+		for (i = 0; i < shadow_num; i++) {
+			d = &shadow[i];
+			d->hits = d->miss = d->elided = d->flushes = 0;
+		}
+		spin_unlock(&shadow_lock);
+	} else {
+		ret = -EINVAL;
+	}
+	return ret < 0 ? ret : count;
 }
 
-static DEVICE_ATTR(stv0900_mis4, 0644,
-		   stv0900_mis4_show,
-		   stv0900_mis4_store);
+static DEVICE_ATTR(i2c_mangle_shadow, 0644,
+		   i2c_mangle_shadow_show,
+		   i2c_mangle_shadow_store);
 
-static ssize_t stv0900_pls1_show
+/*
+ * i2c_mangle_repeater
+ *
+ * read: the time the tuner repeater is kept open after the last tuner access
+ *       in ms (0 = the repeater is opened for each transfer, the default)
+ *       and the open, reused, inserted and close counters
+ * write: <ms> or reset - clear the counters
+ */
+static ssize_t i2c_mangle_repeater_show
   (struct device *dev, struct device_attribute *attr, char *page)
 {
-	return sprintf(page, "%i\n", stv0900_pls[0]);
+	struct repeater *rp;
+	int i, l = 0;
+
+	mutex_lock(&rpt_mutex);
+	l += scnprintf(page + l, PAGE_SIZE - l, "%d\n", i2c_mangle_repeater);
+	for (i = 0; i < ARRAY_SIZE(rpt); i++) {
+		rp = &rpt[i];
+		l += scnprintf(page + l, PAGE_SIZE - l,
+			"0x%02x via 0x%02x:0x%x %s opens %lu reused %lu inserted %lu closes %lu\n",
+			rp->tuner, rp->demod, rp->reg, rp->open ? "open" : "closed",
+			rp->opens, rp->reused, rp->inserted, rp->closes);
+	}
+	mutex_unlock(&rpt_mutex);
+	return l;
 }
 
-static ssize_t stv0900_pls1_store
+static ssize_t i2c_mangle_repeater_store
   (struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
 {
-	int val = 0;
-	if (sscanf(buf, "%i", &val) != 1)
+	int i, val;
+
+	if (!strncmp(buf, "reset", 5)) {
+		mutex_lock(&rpt_mutex);
+		for (i = 0; i < ARRAY_SIZE(rpt); i++)
+			rpt[i].opens = rpt[i].reused = rpt[i].inserted = rpt[i].closes = 0;
+		mutex_unlock(&rpt_mutex);
+		return count;
+	}
+	if (sscanf(buf, "%i", &val) != 1 || val < 0 || val > 10000)
 		return -EINVAL;
-	stv0900_pls[0] = val;
+	mutex_lock(&rpt_mutex);
+	i2c_mangle_repeater = val;
+	mutex_unlock(&rpt_mutex);
+	/* recheck the open repeaters against the new time */
+	cancel_delayed_work_sync(&rpt_work);
+	repeater_close_work(NULL);
 	return count;
 }
 
-static DEVICE_ATTR(stv0900_pls1, 0644,
-		   stv0900_pls1_show,
-		   stv0900_pls1_store);
+static DEVICE_ATTR(i2c_mangle_repeater, 0644,
+		   i2c_mangle_repeater_show,
+		   i2c_mangle_repeater_store);
 
-static ssize_t stv0900_pls2_show
-  (struct device *dev, struct device_attribute *attr, char *page)
+/*
+ * stv0900_plsmis: the MIS and PLS settings of all four demods at once,
+ * binary: s32 mis[4], s32 pls[4] in the CPU byte order
+ */
+static ssize_t stv0900_plsmis_read(struct kobject *kobj, struct bin_attribute *attr,
+				   char *buf, loff_t off, size_t count)
 {
-	return sprintf(page, "%i\n", stv0900_pls[1]);
-}
+	s32 v[8];
+	int i;
 
-static ssize_t stv0900_pls2_store
-  (struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
-{
-	int val = 0;
-	if (sscanf(buf, "%i", &val) != 1)
-		return -EINVAL;
-	stv0900_pls[1] = val;
+	if (off >= sizeof(v))
+		return 0;
+	for (i = 0; i < 4; i++) {
+		v[i] = stv0900_mis[i];
+		v[i + 4] = stv0900_pls[i];
+	}
+	if (count > sizeof(v) - off)
+		count = sizeof(v) - off;
+	memcpy(buf, (char *)v + off, count);
 	return count;
 }
 
-static DEVICE_ATTR(stv0900_pls2, 0644,
-		   stv0900_pls2_show,
-		   stv0900_pls2_store);
-
-static ssize_t stv0900_pls3_show
-  (struct device *dev, struct device_attribute *attr, char *page)
+static ssize_t stv0900_plsmis_write(struct kobject *kobj, struct bin_attribute *attr,
+				    char *buf, loff_t off, size_t count)
 {
-	return sprintf(page, "%i\n", stv0900_pls[2]);
-}
+	s32 v[8];
+	int i;
 
-static ssize_t stv0900_pls3_store
-  (struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
-{
-	int val = 0;
-	if (sscanf(buf, "%i", &val) != 1)
+	if (off != 0 || count != sizeof(v))
 		return -EINVAL;
-	stv0900_pls[2] = val;
+	memcpy(v, buf, sizeof(v));
+	for (i = 0; i < 4; i++) {
+		stv0900_mis[i] = v[i];
+		stv0900_pls[i] = v[i + 4];
+	}
 	return count;
 }
 
-static DEVICE_ATTR(stv0900_pls3, 0644,
-		   stv0900_pls3_show,
-		   stv0900_pls3_store);
+static struct bin_attribute stv0900_plsmis_attr = {
+	.attr = { .name = "stv0900_plsmis", .mode = 0644 },
+	.size = 8 * sizeof(s32),
+	.read = stv0900_plsmis_read,
+	.write = stv0900_plsmis_write,
+};
 
-static ssize_t stv0900_pls4_show
-  (struct device *dev, struct device_attribute *attr, char *page)
-{
-	return sprintf(page, "%i\n", stv0900_pls[3]);
-}
+static struct attribute *i2c_mangle_attrs[] = {
+	&dev_attr_i2c_mangle_enable.attr,
+	&dev_attr_i2c_mangle_debug.attr,
+	&dev_attr_i2c_mangle_rules.attr,
+	&dev_attr_i2c_mangle_shadow.attr,
+	&dev_attr_i2c_mangle_repeater.attr,
+	&dev_attr_stv6120_gain.attr,
+	&dev_attr_stv0900_mis1.attr,
+	&dev_attr_stv0900_mis2.attr,
+	&dev_attr_stv0900_mis3.attr,
+	&dev_attr_stv0900_mis4.attr,
+	&dev_attr_stv0900_pls1.attr,
+	&dev_attr_stv0900_pls2.attr,
+	&dev_attr_stv0900_pls3.attr,
+	&dev_attr_stv0900_pls4.attr,
+	NULL
+};
 
-static ssize_t stv0900_pls4_store
-  (struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
-{
-	int val = 0;
-	if (sscanf(buf, "%i", &val) != 1)
-		return -EINVAL;
-	stv0900_pls[3] = val;
-	return count;
-}
-
-static DEVICE_ATTR(stv0900_pls4, 0644,
-		   stv0900_pls4_show,
-		   stv0900_pls4_store);
+static struct attribute_group i2c_mangle_group = {
+	.attrs = i2c_mangle_attrs,
+};
 
 static void sysfs_create_entries(void)
 {
-	struct kobject *kobj = &i2c_adapter0->dev.kobj;
-
-	sysfs_create_file(kobj, &dev_attr_i2c_mangle_enable.attr);
-	sysfs_create_file(kobj, &dev_attr_i2c_mangle_debug.attr);
-	sysfs_create_file(kobj, &dev_attr_stv6120_gain.attr);
-	sysfs_create_file(kobj, &dev_attr_stv0900_mis1.attr);
-	sysfs_create_file(kobj, &dev_attr_stv0900_mis2.attr);
-	sysfs_create_file(kobj, &dev_attr_stv0900_mis3.attr);
-	sysfs_create_file(kobj, &dev_attr_stv0900_mis4.attr);
-	sysfs_create_file(kobj, &dev_attr_stv0900_pls1.attr);
-	sysfs_create_file(kobj, &dev_attr_stv0900_pls2.attr);
-	sysfs_create_file(kobj, &dev_attr_stv0900_pls3.attr);
-	sysfs_create_file(kobj, &dev_attr_stv0900_pls4.attr);
+	if (sysfs_create_group(&i2c_adapter0->dev.kobj, &i2c_mangle_group) ||
+	    sysfs_create_bin_file(&i2c_adapter0->dev.kobj, &stv0900_plsmis_attr))
+		printk(KERN_ERR "i2c_mangle: unable to create sysfs entries\n");
 }
 
 static void sysfs_remove_entries(void)
 {
-	struct kobject *kobj = &i2c_adapter0->dev.kobj;
-
-	sysfs_remove_file(kobj, &dev_attr_i2c_mangle_enable.attr);
-	sysfs_remove_file(kobj, &dev_attr_i2c_mangle_debug.attr);
-	sysfs_remove_file(kobj, &dev_attr_stv6120_gain.attr);
-	sysfs_remove_file(kobj, &dev_attr_stv0900_mis1.attr);
-	sysfs_remove_file(kobj, &dev_attr_stv0900_mis2.attr);
-	sysfs_remove_file(kobj, &dev_attr_stv0900_mis3.attr);
-	sysfs_remove_file(kobj, &dev_attr_stv0900_mis4.attr);
-	sysfs_remove_file(kobj, &dev_attr_stv0900_pls1.attr);
-	sysfs_remove_file(kobj, &dev_attr_stv0900_pls2.attr);
-	sysfs_remove_file(kobj, &dev_attr_stv0900_pls3.attr);
-	sysfs_remove_file(kobj, &dev_attr_stv0900_pls4.attr);
+	sysfs_remove_bin_file(&i2c_adapter0->dev.kobj, &stv0900_plsmis_attr);
+	sysfs_remove_group(&i2c_adapter0->dev.kobj, &i2c_mangle_group);
 }
 
 /*
@@ -424,6 +1145,14 @@ int init_module(void)
 		printk(KERN_ERR "i2c_mangle: unable to find adapter 0\n");
 		return -ENODEV;
 	}
+	rules_cur = kzalloc(sizeof(*rules_cur), GFP_KERNEL);
+	if (rules_cur == NULL) {
+		i2c_put_adapter(i2c_adapter0);
+		return -ENOMEM;
+	}
+	atomic_set(&rules_cur->ref, 1);
+	rules_builtin(rules_cur);
+	shadow_builtin();
 	sysfs_create_entries();
 	i2c_transfer_mangle = i2c_transfer_axe;
 	printk(KERN_INFO "I2C-Bus AXE mangle module loaded\n");
@@ -434,6 +1163,10 @@ void cleanup_module(void)
 {
 	sysfs_remove_entries();
 	i2c_transfer_mangle = NULL;
+	i2c_mangle_repeater = 0;
+	cancel_delayed_work_sync(&rpt_work);
+	repeater_close_work(NULL);
+	rules_put(rules_cur);
 	i2c_put_adapter(i2c_adapter0);
 }
 
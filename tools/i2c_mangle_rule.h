@@ -0,0 +1,153 @@
+#ifndef I2C_MANGLE_RULE_H
+#define I2C_MANGLE_RULE_H
+
+/*
+ * Rule engine of the i2c_mangle module
+ *
+ * The matching and mangling of the write messages has no kernel
+ * dependencies, the host simulator (i2c-sim.c) builds the same code so
+ * the rules can be tried with axehelper / senddsq without the hardware.
+ * The includer provides u8 / u16, struct i2c_msg, sscanf(), the errno
+ * values and
+ *   RULE_DEBUG(fmt, args...)  - trace of the mangled bytes
+ *   inject_seq()              - sends the seq table of an INJECT rule
+ *
+ * MASK rule: the data written to the registers reg_lo..reg_hi get
+ *            (data & ~(mask << shift)) | ((val & mask) << shift)
+ * INJECT rule: a write of val to reg_lo is preceded by the writes from
+ *            the seq table (or by the inject callback for the builtin rules)
+ */
+
+#define RULE_MASK	1
+#define RULE_INJECT	2
+
+#define MAX_RULES	32
+#define MAX_INJECT	4
+
+struct i2c_adapter;
+
+struct mangle_rule {
+	u8 type;
+	u8 addr;
+	u8 reglen;		/* register address length (1 or 2 bytes) */
+	u8 next;		/* next rule for the same address + 1, 0 = end */
+	u16 reg_lo, reg_hi;
+	u8 mask, shift;
+	int val;
+	int *var;		/* builtin rules take the value from a parameter */
+	void (*inject)(struct i2c_adapter *adap, struct i2c_msg *src, struct mangle_rule *r);
+	int nseq;
+	u16 seq[MAX_INJECT][2];
+	unsigned long hits;
+	unsigned long injected;
+};
+
+static void inject_seq(struct i2c_adapter *adap, struct i2c_msg *src, struct mangle_rule *rule);
+
+/*
+ * one i2c_mangle_rules line, v gets the numbers, returns their count
+ * (-1 when there is no command)
+ */
+static int rule_scan(const char *buf, char *cmd, int *v)
+{
+	return sscanf(buf, "%7s %i %i %i %i %i %i %i %i %i %i %i %i %i", cmd,
+		      &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6],
+		      &v[7], &v[8], &v[9], &v[10], &v[11], &v[12]) - 1;
+}
+
+/*
+ * fill r from a "mask" or "inject" line scanned by rule_scan()
+ */
+static int rule_parse(struct mangle_rule *r, const char *cmd, int *v, int n)
+{
+	int i;
+
+	memset(r, 0, sizeof(*r));
+	if (n < 1 || v[0] < 0 || v[0] > 0x7f)
+		return -EINVAL;
+	if (!strcmp(cmd, "mask") && n == 7) {
+		r->type = RULE_MASK;
+		r->addr = v[0];
+		r->reglen = v[1];
+		r->reg_lo = v[2];
+		r->reg_hi = v[3];
+		r->mask = v[4];
+		r->shift = v[5];
+		r->val = v[6];
+	} else if (!strcmp(cmd, "inject") && n >= 6 && (n & 1) == 0) {
+		r->type = RULE_INJECT;
+		r->addr = v[0];
+		r->reglen = v[1];
+		r->reg_lo = r->reg_hi = v[2];
+		r->val = v[3];
+		r->nseq = (n - 4) / 2;
+		for (i = 0; i < r->nseq; i++) {
+			r->seq[i][0] = v[4 + i * 2];
+			r->seq[i][1] = v[5 + i * 2];
+		}
+	} else {
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int rule_check(struct mangle_rule *r)
+{
+	if (r->addr > 0x7f || r->reglen < 1 || r->reglen > 2 ||
+	    r->reg_lo > r->reg_hi || r->shift > 7)
+		return -EINVAL;
+	return 0;
+}
+
+static void mangle(u8 *dst, struct i2c_msg *m, int i, int val, int shift, int mask)
+{
+	u8 old = m->buf[i];
+
+	if (m->buf != dst) {
+		memcpy(dst, m->buf, m->len);
+		m->buf = dst;
+	}
+	dst[i] &= ~(mask << shift);
+	dst[i] |= (val & mask) << shift;
+	RULE_DEBUG("i2c mangle: i=%d val=0x%x shift=%i mask=0x%x (orig 0x%x new 0x%x)\n",
+		   i, val, shift, mask, old, dst[i]);
+}
+
+/*
+ * mbuf (32 bytes) takes the mangled copy of the message data, m->buf is
+ * pointed to it, the caller's data are not modified
+ */
+static void rule_apply(struct i2c_adapter *adap, struct mangle_rule *rule,
+		       struct i2c_msg *m, u8 *mbuf)
+{
+	int reg, i, l = rule->reglen;
+
+	if (m->len <= l)
+		return;
+	reg = l == 2 ? (m->buf[0] << 8) | m->buf[1] : m->buf[0];
+	if (rule->type == RULE_MASK) {
+		/* the register address auto-increments with every data byte */
+		if (reg > rule->reg_hi || reg + m->len - l - 1 < rule->reg_lo)
+			return;
+		if (m->len > 32)
+			return;
+		rule->hits++;
+		for (i = l; i < m->len; i++, reg++)
+			if (reg >= rule->reg_lo && reg <= rule->reg_hi)
+				mangle(mbuf, m, i, rule->var ? *rule->var : rule->val,
+				       rule->shift, rule->mask);
+	} else if (rule->type == RULE_INJECT) {
+		if (m->flags != 0 || m->len != l + 1 ||
+		    reg != rule->reg_lo || m->buf[l] != rule->val)
+			return;
+		rule->hits++;
+		if (rule->inject) {
+			rule->inject(adap, m, rule);
+		} else if (rule->nseq > 0) {
+			inject_seq(adap, m, rule);
+			rule->injected += rule->nseq;
+		}
+	}
+}
+
+#endif
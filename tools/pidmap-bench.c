@@ -0,0 +1,324 @@
+/*
+ * Host benchmark for the minisatip PID fan-out table (src/pidmap.h)
+ *
+ * Feeds a recorded TS file through the multi-stream demux path with
+ * 1..16 simulated sessions. The "scan" column models the old per-packet
+ * path (find_pid() linear scan + walk over the sids of the PID for every
+ * packet), the "table" column runs the pidmap.h code used by process_dmx():
+ * the table is built from the pid table the way pidmap_get() does it, the
+ * runs from pidmap_next() are split to datagrams and queued to the stream
+ * iovecs the same way. Both paths must send the same packets in datagrams
+ * of at most ARRAY_SIZE(iov) packets.
+ *
+ * usage: pidmap-bench.x86_64 <file.ts> [passes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#define DVB_FRAME 188
+#define MAX_PIDS 128
+#define MAX_STREAMS 100	/* src/stream.h */
+#define MAX_STREAMS_PER_PID 16
+#define MAX_SESSIONS 16
+#define PID_FROM_TS(b) (((b)[1] & 0x1F) * 256 + (b)[2])
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+
+#include "pidmap.h"
+
+typedef struct {
+	int pid;
+	int flags;
+	int sid[MAX_STREAMS_PER_PID];
+	uint64_t cnt;
+} spid;
+
+/* the part of struct_streams process_dmx() touches */
+typedef struct {
+	struct iovec iov[7];
+	int iiov;
+	uint64_t pkts;
+	uint64_t iovs;
+	uint64_t dgrams;
+	int oversize;	/* datagrams over ARRAY_SIZE(iov) packets */
+} sstream;
+
+SPidmap *pidmap[1];
+
+static spid pids[MAX_PIDS];
+static sstream sess[MAX_SESSIONS];
+
+static uint64_t
+getTickNs ()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+flush_streami (sstream *s)
+{
+	int i, len = 0;
+
+	if (s->iiov == 0)
+		return;
+	for (i = 0; i < s->iiov; i++)
+		len += s->iov[i].iov_len;
+	if (len > ARRAY_SIZE(s->iov) * DVB_FRAME)
+		s->oversize++;
+	s->pkts += len / DVB_FRAME;
+	s->iovs += s->iiov;
+	s->dgrams++;
+	s->iiov = 0;
+}
+
+static spid *
+find_pid (int pid)
+{
+	int i;
+
+	for (i = 0; i < MAX_PIDS; i++)
+		if (pids[i].flags > 0 && pids[i].pid == pid)
+			return pids + i;
+	return NULL;
+}
+
+static void
+add_pid (int sid, int pid)
+{
+	spid *p = find_pid(pid);
+	int i;
+
+	if (!p) {
+		for (i = 0; i < MAX_PIDS; i++)
+			if (pids[i].flags <= 0)
+				break;
+		if (i >= MAX_PIDS)
+			return;
+		p = pids + i;
+		p->pid = pid;
+		p->flags = 1;
+		memset(p->sid, -1, sizeof(p->sid));
+	}
+	for (i = 0; i < MAX_STREAMS_PER_PID; i++)
+		if (p->sid[i] < 0) {
+			p->sid[i] = sid;
+			break;
+		}
+}
+
+static void
+run_scan (unsigned char *buf, int len)
+{
+	unsigned char *b;
+	sstream *s;
+	spid *p;
+	int i;
+
+	for (b = buf; b + DVB_FRAME <= buf + len; b += DVB_FRAME) {
+		p = find_pid(PID_FROM_TS(b));
+		if (!p)
+			continue;
+		p->cnt++;
+		for (i = 0; i < MAX_STREAMS_PER_PID; i++)
+			if (p->sid[i] >= 0) {
+				s = &sess[p->sid[i]];
+				if (s->iiov >= ARRAY_SIZE(s->iov))
+					flush_streami(s);
+				s->iov[s->iiov].iov_base = b;
+				s->iov[s->iiov++].iov_len = DVB_FRAME;
+			}
+	}
+}
+
+/* pidmap_get() */
+static SPidmap *
+table_get (void)
+{
+	SPidmap *m = pidmap[0];
+	int i, j;
+
+	pidmap_key_begin(m);
+	for (i = 0; i < MAX_PIDS; i++)
+		if (pids[i].flags > 0) {
+			pidmap_key(m, -1 - i);
+			pidmap_key(m, pids[i].pid);
+			for (j = 0; j < MAX_STREAMS_PER_PID; j++)
+				if (pids[i].sid[j] >= 0)
+					pidmap_key(m, pids[i].sid[j]);
+		}
+	return pidmap_key_end(m, MAX_STREAMS) ? NULL : m;
+}
+
+static void
+run_table (unsigned char *buf, int len)
+{
+	SPidmapIter it;
+	SPidmap *m = table_get();
+	unsigned char *b;
+	sstream *s;
+	int k, n, left;
+
+	if (!m)
+		return;
+	for (k = 0; k + DVB_FRAME <= len; k += DVB_FRAME)
+		if ((n = pidmap_slot(m, PID_FROM_TS(buf + k))))
+			pids[n - 1].cnt++;
+	pidmap_iter_init(&it, m, buf, len);
+	while (pidmap_next(&it)) {
+		s = &sess[it.sid];
+		for (b = it.run, left = it.len; left > 0; b += n, left -= n) {
+			n = pidmap_room(s->iov, s->iiov, ARRAY_SIZE(s->iov));
+			if (n <= 0 || s->iiov >= ARRAY_SIZE(s->iov)) {
+				flush_streami(s);
+				n = ARRAY_SIZE(s->iov) * DVB_FRAME;
+			}
+			if (n > left)
+				n = left;
+			s->iov[s->iiov].iov_base = b;
+			s->iov[s->iiov++].iov_len = n;
+		}
+	}
+}
+
+static int
+setup (int sessions, int *tspids, int ntspids)
+{
+	int s, i;
+
+	memset(pids, 0, sizeof(pids));
+	if (!pidmap[0] &&
+	    !(pidmap[0] = pidmap_alloc(MAX_STREAMS, MAX_PIDS * (2 + MAX_STREAMS_PER_PID))))
+		return -1;
+	/* every session gets PAT and a share of the other pids (services) */
+	for (s = 0; s < sessions; s++) {
+		add_pid(s, 0);
+		for (i = 0; i < ntspids; i++)
+			if (tspids[i] != 0 && (i % sessions) == s)
+				add_pid(s, tspids[i]);
+	}
+	return table_get() ? 0 : -1;
+}
+
+struct result {
+	uint64_t pkts, iovs, dgrams;
+	int oversize;
+	uint64_t cnt[MAX_PIDS];
+};
+
+static uint64_t
+bench (void (*fcn)(unsigned char *, int), unsigned char *buf, int len,
+       int chunk, int passes, struct result *res)
+{
+	uint64_t t;
+	int i, p;
+
+	memset(sess, 0, sizeof(sess));
+	for (i = 0; i < MAX_PIDS; i++)
+		pids[i].cnt = 0;
+	t = getTickNs();
+	for (p = 0; p < passes; p++)
+		for (i = 0; i < len; i += chunk)
+			fcn(buf + i, len - i < chunk ? len - i : chunk);
+	for (i = 0; i < MAX_SESSIONS; i++)
+		flush_streami(&sess[i]);
+	t = getTickNs() - t;
+	memset(res, 0, sizeof(*res));
+	for (i = 0; i < MAX_SESSIONS; i++) {
+		res->pkts += sess[i].pkts;
+		res->iovs += sess[i].iovs;
+		res->dgrams += sess[i].dgrams;
+		res->oversize += sess[i].oversize;
+	}
+	for (i = 0; i < MAX_PIDS; i++)
+		res->cnt[i] = pids[i].cnt;
+	return t;
+}
+
+int main(int argc, char *argv[])
+{
+	static unsigned char seen[8192];
+	unsigned char *buf;
+	struct stat st;
+	int fd, len, i, pid, sessions, passes = 10, chunk = 348 * DVB_FRAME;
+	int tspids[8192], ntspids = 0;
+	uint64_t ts, tt, npkts;
+	struct result sr, tr;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <file.ts> [passes]\n", argv[0]);
+		return 1;
+	}
+	if (argc > 2)
+		passes = atoi(argv[2]);
+	if (passes < 1)
+		passes = 1;
+	fd = open(argv[1], O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		perror(argv[1]);
+		return 1;
+	}
+	len = st.st_size - st.st_size % DVB_FRAME;
+	buf = malloc(len);
+	if (!buf || read(fd, buf, len) != len) {
+		perror("read");
+		return 1;
+	}
+	close(fd);
+	for (i = 0; i < len; i += DVB_FRAME) {
+		if (buf[i] != 0x47) {
+			fprintf(stderr, "sync lost at offset %d\n", i);
+			return 1;
+		}
+		pid = PID_FROM_TS(buf + i);
+		if (pid != 0x1FFF && !seen[pid]) {
+			seen[pid] = 1;
+			if (ntspids < MAX_PIDS - 1)
+				tspids[ntspids++] = pid;
+		}
+	}
+	npkts = (uint64_t)(len / DVB_FRAME) * passes;
+	printf("%d packets, %d pids, %d passes, %d bytes per read\n",
+	       len / DVB_FRAME, ntspids, passes, chunk);
+	printf("sessions  scan ns/pkt  table ns/pkt  speedup  iovs scan/table\n");
+	for (sessions = 1; sessions <= MAX_SESSIONS; sessions++) {
+		if (setup(sessions, tspids, ntspids)) {
+			fprintf(stderr, "pidmap allocation failed\n");
+			return 1;
+		}
+		ts = bench(run_scan, buf, len, chunk, passes, &sr);
+		tt = bench(run_table, buf, len, chunk, passes, &tr);
+		if (sr.pkts != tr.pkts || sr.dgrams != tr.dgrams) {
+			fprintf(stderr, "packet/datagram count mismatch %llu/%llu != %llu/%llu\n",
+				(unsigned long long)sr.pkts, (unsigned long long)sr.dgrams,
+				(unsigned long long)tr.pkts, (unsigned long long)tr.dgrams);
+			return 1;
+		}
+		if (sr.oversize || tr.oversize) {
+			fprintf(stderr, "%d/%d datagrams over %d packets\n",
+				sr.oversize, tr.oversize, (int)ARRAY_SIZE(sess[0].iov));
+			return 1;
+		}
+		if (memcmp(sr.cnt, tr.cnt, sizeof(sr.cnt))) {
+			fprintf(stderr, "pid packet counter mismatch\n");
+			return 1;
+		}
+		printf("%8d  %11.2f  %12.2f  %6.2fx  %llu/%llu\n", sessions,
+		       (double)ts / npkts, (double)tt / npkts,
+		       tt ? (double)ts / tt : 0.0,
+		       (unsigned long long)sr.iovs, (unsigned long long)tr.iovs);
+	}
+	free(buf);
+	return 0;
+}